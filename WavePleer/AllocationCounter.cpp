@@ -0,0 +1,156 @@
+﻿#include "AllocationCounter.h"
+
+#ifdef WAVEPLEER_COUNT_ALLOCATIONS
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    const char* const SubsystemNames[AllocationCounter::SubsystemCount] = {
+        "events", "library", "playback", "covers", "animation", "render"
+    };
+
+    // Считаются только выделения потока, начавшего кадр. Фоновые потоки выделяют память свободно.
+    thread_local bool t_isCounting = false;
+    thread_local int  t_subsystem = AllocationCounter::Events;
+
+    std::size_t   s_counts[AllocationCounter::SubsystemCount];
+    std::size_t   s_bytes[AllocationCounter::SubsystemCount];
+    unsigned long s_frame = 0;
+    bool          s_hasFailed = false;
+
+    // Проверка без участия человека: сколько устойчивых кадров нужно, сколько уже было и до какого времени.
+    // Если за это время устойчивых кадров не набралось, что-то постоянно меняется, и проверка не удалась.
+    const std::chrono::seconds CheckTimeout(120);
+    unsigned long s_steadyTarget = 0;
+    unsigned long s_steadyFrames = 0;
+    std::chrono::steady_clock::time_point s_checkDeadline;
+
+    void* allocate(std::size_t size) {
+        if (t_isCounting) {
+            ++s_counts[t_subsystem];
+            s_bytes[t_subsystem] += size;
+        }
+
+        void* pointer = std::malloc(size != 0 ? size : 1);
+        if (!pointer)
+            throw std::bad_alloc();
+        return pointer;
+    }
+}
+
+void AllocationCounter::beginFrame() {
+    for (int i = 0; i < SubsystemCount; ++i) {
+        s_counts[i] = 0;
+        s_bytes[i] = 0;
+    }
+    t_subsystem = Events;
+    t_isCounting = true;
+}
+
+void AllocationCounter::setSubsystem(Subsystem subsystem) {
+    t_subsystem = subsystem;
+}
+
+void AllocationCounter::endFrame(bool isSteady) {
+    t_isCounting = false;
+    ++s_frame;
+    if (!isSteady)
+        return;
+
+    ++s_steadyFrames;
+
+    // Печатаем через stdio без std::string, чтобы отчет сам не выделял память в operator new.
+    for (int i = 0; i < SubsystemCount; ++i) {
+        if (s_counts[i] == 0)
+            continue;
+        s_hasFailed = true;
+        std::fprintf(stderr, "Frame %lu: %s allocated %zu times (%zu bytes)\n", s_frame, SubsystemNames[i], s_counts[i], s_bytes[i]);
+    }
+}
+
+bool AllocationCounter::hasFailed() {
+    return s_hasFailed;
+}
+
+void AllocationCounter::startCheck() {
+    const char* frames = std::getenv("WAVEPLEER_STEADY_FRAMES");
+    if (!frames)
+        return;
+
+    s_steadyTarget = std::strtoul(frames, nullptr, 10);
+    s_checkDeadline = std::chrono::steady_clock::now() + CheckTimeout;
+}
+
+bool AllocationCounter::isChecking() {
+    return s_steadyTarget > 0;
+}
+
+bool AllocationCounter::isCheckFinished() {
+    if (s_steadyTarget == 0)
+        return false;
+    if (s_steadyFrames >= s_steadyTarget) {
+        std::fprintf(stderr, "%lu steady frames checked\n", s_steadyFrames);
+        return true;
+    }
+    if (std::chrono::steady_clock::now() < s_checkDeadline)
+        return false;
+
+    s_hasFailed = true;
+    std::fprintf(stderr, "Only %lu of %lu steady frames in %lld s\n", s_steadyFrames, s_steadyTarget, static_cast<long long>(CheckTimeout.count()));
+    return true;
+}
+
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+#endif
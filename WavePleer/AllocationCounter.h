@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <cstddef>
+
+// Подсчет выделений памяти в кадре (сборка с макросом WAVEPLEER_COUNT_ALLOCATIONS).
+// В этой сборке глобальные operator new/delete считают выделения UI-потока между beginFrame
+// и endFrame с разбивкой по подсистемам. Устойчивый кадр — тот, в котором ничего не произошло:
+// не было событий, изменений медиатеки, смены трека или обложки. Такой кадр не должен выделять
+// память: каждое нарушение печатается в std::cerr, а hasFailed сообщает о нем, чтобы программа
+// завершилась с ненулевым кодом. Эту сборку дает конфигурация Release-Alloc.
+// Проверка без участия человека (check-allocations.ps1): при переменной окружения
+// WAVEPLEER_STEADY_FRAMES=N программа сама запускает первый трек и завершается, набрав N устойчивых кадров.
+// В обычной сборке все функции пустые.
+namespace AllocationCounter {
+    enum Subsystem {
+        Events,
+        Library,
+        Playback,
+        Covers,
+        Animation,
+        Render,
+        SubsystemCount
+    };
+
+#ifdef WAVEPLEER_COUNT_ALLOCATIONS
+    // Начинает подсчет выделений UI-потока.
+    void beginFrame();
+
+    // Последующие выделения кадра относятся к подсистеме subsystem.
+    void setSubsystem(Subsystem subsystem);
+
+    // Заканчивает кадр. isSteady — в кадре ничего не произошло, и выделений быть не должно.
+    void endFrame(bool isSteady);
+
+    // Выделял ли память хотя бы один устойчивый кадр.
+    bool hasFailed();
+
+    // Читает WAVEPLEER_STEADY_FRAMES и, если она задана, начинает проверку.
+    void startCheck();
+
+    // Идет ли проверка: главный цикл не должен засыпать надолго.
+    bool isChecking();
+
+    // Проверка набрала нужное число устойчивых кадров или не успела за отведенное время (это тоже ошибка).
+    bool isCheckFinished();
+#else
+    inline void beginFrame() {}
+    inline void setSubsystem(Subsystem) {}
+    inline void endFrame(bool) {}
+    inline bool hasFailed() { return false; }
+    inline void startCheck() {}
+    inline bool isChecking() { return false; }
+    inline bool isCheckFinished() { return false; }
+#endif
+}
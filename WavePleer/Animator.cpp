@@ -0,0 +1,91 @@
+﻿#include "Animator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Шаг анимаций: 120 шагов в секунду.
+    const sf::Time Step = sf::microseconds(1000000 / 120);
+
+    // После долгой паузы (например, окно не отвечало) анимации не догоняют упущенное время.
+    const sf::Int64 MaxStepsPerUpdate = 30;
+
+    // Обычно анимаций несколько, массив не должен расти в кадре.
+    const std::size_t ReservedTweens = 32;
+}
+
+Animator::Animator() {
+    m_tweens.reserve(ReservedTweens);
+}
+
+void Animator::start(void* target, int channel, Setter setter, float from, float to, sf::Time duration) {
+    // Первая анимация отсчитывает шаги с момента запуска, а не с конца прошлой.
+    if (m_tweens.empty()) {
+        m_clock.restart();
+        m_lastStep = sf::Time::Zero;
+    }
+
+    auto found = std::find_if(m_tweens.begin(), m_tweens.end(), [target, channel](const Tween& tween) {
+        return tween.target == target && tween.channel == channel;
+    });
+
+    int steps = static_cast<int>(std::ceil(duration.asSeconds() / Step.asSeconds()));
+    if (steps <= 0) {
+        if (found != m_tweens.end()) {
+            *found = m_tweens.back();
+            m_tweens.pop_back();
+        }
+        setter(target, channel, to);
+        return;
+    }
+
+    Tween tween = { target, channel, setter, from, to, steps, 0 };
+    if (found != m_tweens.end())
+        *found = tween;
+    else
+        m_tweens.push_back(tween);
+    setter(target, channel, from);
+}
+
+bool Animator::update() {
+    if (m_tweens.empty())
+        return false;
+
+    sf::Time now = m_clock.getElapsedTime();
+    sf::Int64 steps = (now - m_lastStep).asMicroseconds() / Step.asMicroseconds();
+    if (steps <= 0)
+        return false;
+    if (steps > MaxStepsPerUpdate) {
+        steps = MaxStepsPerUpdate;
+        m_lastStep = now;
+    }
+    else {
+        m_lastStep += Step * steps;
+    }
+
+    // Законченные анимации заменяются последней, чтобы массив оставался сплошным.
+    for (std::size_t i = 0; i < m_tweens.size();) {
+        Tween& tween = m_tweens[i];
+        tween.elapsed = static_cast<int>(std::min<sf::Int64>(tween.elapsed + steps, tween.duration));
+        float t = static_cast<float>(tween.elapsed) / tween.duration;
+        tween.setter(tween.target, tween.channel, tween.from + (tween.to - tween.from) * t);
+
+        if (tween.elapsed == tween.duration) {
+            tween = m_tweens.back();
+            m_tweens.pop_back();
+        }
+        else {
+            ++i;
+        }
+    }
+
+    return true;
+}
+
+bool Animator::isActive() const {
+    return !m_tweens.empty();
+}
+
+sf::Time Animator::getTimeToNextStep() const {
+    return std::max(sf::Time::Zero, m_lastStep + Step - m_clock.getElapsedTime());
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <vector>
+
+#include <SFML/System.hpp>
+
+// Анимации интерфейса с фиксированным шагом.
+// Анимация плавно меняет число (например, прозрачность кнопки) от from до to и передает каждое
+// новое значение функции setter. Активные анимации лежат подряд в одном массиве и продвигаются
+// одним вызовом update на целое число шагов Step, поэтому их ход не зависит от частоты кадров,
+// а стоимость кадра зависит только от числа идущих анимаций.
+// Между шагами значения не меняются: getTimeToNextStep подсказывает, когда нужен следующий кадр.
+class Animator {
+public:
+    // Применяет значение анимации к объекту. channel различает анимации одного объекта.
+    typedef void (*Setter)(void* target, int channel, float value);
+
+    Animator();
+
+    // Запускает анимацию, заменяя идущую анимацию того же объекта и канала.
+    // Значение from применяется сразу.
+    void start(void* target, int channel, Setter setter, float from, float to, sf::Time duration);
+
+    // Продвигает анимации на прошедшие шаги. Возвращает true, если какое-то значение изменилось.
+    bool update();
+
+    bool isActive() const;
+
+    // Время до следующего шага анимаций.
+    sf::Time getTimeToNextStep() const;
+
+private:
+    struct Tween {
+        void*  target;
+        int    channel;
+        Setter setter;
+        float  from;
+        float  to;
+        int    duration;  // в шагах
+        int    elapsed;   // в шагах
+    };
+
+    std::vector<Tween> m_tweens;
+    sf::Clock          m_clock;
+    sf::Time           m_lastStep;   // время последнего шага по m_clock
+};
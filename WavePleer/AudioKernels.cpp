@@ -0,0 +1,334 @@
+﻿#include "AudioKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAVEPLEER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#define WAVEPLEER_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    const float Int16Scale = 32768.f;
+
+    // Генератор xorshift32: по слову состояния на каждую полосу SIMD.
+    std::uint32_t nextRandom(std::uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Равномерный шум в [-0.5, 0.5) младшего разряда из старших 24 бит слова.
+    float toNoise(std::uint32_t random) {
+        return static_cast<float>(static_cast<std::int32_t>(random) >> 8) * (1.f / 16777216.f);
+    }
+
+#ifdef WAVEPLEER_SSE2
+    __m128i nextRandom(__m128i& state) {
+        state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+        state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+        state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+        return state;
+    }
+
+    __m128 toNoise(__m128i random) {
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(random, 8)), _mm_set1_ps(1.f / 16777216.f));
+    }
+#endif
+
+#ifdef WAVEPLEER_AVX2
+    __m256i nextRandom(__m256i& state) {
+        state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+        state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+        state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+        return state;
+    }
+
+    __m256 toNoise(__m256i random) {
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(random, 8)), _mm256_set1_ps(1.f / 16777216.f));
+    }
+#endif
+}
+
+void mixCrossfade(const sf::Int16* outgoing, const sf::Int16* incoming, sf::Int16* output, std::size_t sampleCount, unsigned int channelCount, float fadePosition, float fadeStep) {
+    std::size_t i = 0;
+
+#ifdef WAVEPLEER_SSE2
+    // Моно и стерео обрабатываем по 8 сэмплов: номера кадров внутри блока известны заранее.
+    if (channelCount == 1 || channelCount == 2) {
+        const __m128 step = _mm_set1_ps(fadeStep);
+        const __m128 framesLo = channelCount == 1 ? _mm_setr_ps(0.f, 1.f, 2.f, 3.f) : _mm_setr_ps(0.f, 0.f, 1.f, 1.f);
+        const __m128 framesHi = channelCount == 1 ? _mm_setr_ps(4.f, 5.f, 6.f, 7.f) : _mm_setr_ps(2.f, 2.f, 3.f, 3.f);
+        const __m128 gainStepLo = _mm_mul_ps(step, framesLo);
+        const __m128 gainStepHi = _mm_mul_ps(step, framesHi);
+
+        for (; i + 8 <= sampleCount; i += 8) {
+            const __m128 base = _mm_set1_ps(fadePosition + fadeStep * static_cast<float>(i / channelCount));
+            const __m128 gainLo = _mm_add_ps(base, gainStepLo);
+            const __m128 gainHi = _mm_add_ps(base, gainStepHi);
+
+            // Расширяем Int16 до float со знаком.
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(outgoing + i));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(incoming + i));
+            const __m128 aLo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16));
+            const __m128 aHi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16));
+            const __m128 bLo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16));
+            const __m128 bHi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(b, b), 16));
+
+            // a * (1 - g) + b * g = a + (b - a) * g
+            const __m128 mixedLo = _mm_add_ps(aLo, _mm_mul_ps(_mm_sub_ps(bLo, aLo), gainLo));
+            const __m128 mixedHi = _mm_add_ps(aHi, _mm_mul_ps(_mm_sub_ps(bHi, aHi), gainHi));
+
+            // Округляем и упаковываем обратно в Int16 с насыщением.
+            const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(mixedLo), _mm_cvtps_epi32(mixedHi));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), packed);
+        }
+    }
+#endif
+
+    // Остаток блока и произвольное число каналов.
+    for (; i < sampleCount; ++i) {
+        float gain = fadePosition + fadeStep * static_cast<float>(i / channelCount);
+        float a = outgoing[i];
+        float b = incoming[i];
+        output[i] = static_cast<sf::Int16>(std::lrint(a + (b - a) * gain));
+    }
+}
+
+void scaleInt16(sf::Int16* samples, std::size_t sampleCount, float gain) {
+    std::size_t i = 0;
+
+#ifdef WAVEPLEER_SSE2
+    const __m128 gain128 = _mm_set1_ps(gain);
+    for (; i + 8 <= sampleCount; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        const __m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16)), gain128);
+        const __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16)), gain128);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+    }
+#endif
+
+    for (; i < sampleCount; ++i) {
+        float value = std::nearbyint(samples[i] * gain);
+        samples[i] = static_cast<sf::Int16>(std::max(-32768.f, std::min(value, 32767.f)));
+    }
+}
+
+void convertToFloat(const sf::Int16* input, float* output, std::size_t sampleCount) {
+    std::size_t i = 0;
+
+#ifdef WAVEPLEER_AVX2
+    const __m256 scale256 = _mm256_set1_ps(1.f / Int16Scale);
+    for (; i + 16 <= sampleCount; i += 16) {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 8));
+        _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(lo)), scale256));
+        _mm256_storeu_ps(output + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(hi)), scale256));
+    }
+#endif
+
+#ifdef WAVEPLEER_SSE2
+    const __m128 scale = _mm_set1_ps(1.f / Int16Scale);
+    for (; i + 8 <= sampleCount; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16)), scale));
+        _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16)), scale));
+    }
+#endif
+
+    for (; i < sampleCount; ++i)
+        output[i] = input[i] * (1.f / Int16Scale);
+}
+
+void convertToInt16Dithered(const float* input, sf::Int16* output, std::size_t sampleCount, std::uint32_t* ditherState) {
+    std::size_t i = 0;
+
+    // Сумма двух равномерных шумов дает треугольное распределение в ±1 младший разряд.
+#ifdef WAVEPLEER_AVX2
+    {
+        __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ditherState));
+        const __m256 scale = _mm256_set1_ps(Int16Scale);
+        for (; i + 16 <= sampleCount; i += 16) {
+            __m256 lo = _mm256_mul_ps(_mm256_loadu_ps(input + i), scale);
+            __m256 hi = _mm256_mul_ps(_mm256_loadu_ps(input + i + 8), scale);
+            lo = _mm256_add_ps(lo, _mm256_add_ps(toNoise(nextRandom(state)), toNoise(nextRandom(state))));
+            hi = _mm256_add_ps(hi, _mm256_add_ps(toNoise(nextRandom(state)), toNoise(nextRandom(state))));
+
+            // Упаковка AVX2 идет внутри 128-битных половин, поэтому восстанавливаем порядок перестановкой.
+            const __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_permute4x64_epi64(packed, 0xD8));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ditherState), state);
+    }
+#endif
+
+#ifdef WAVEPLEER_SSE2
+    {
+        __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ditherState));
+        const __m128 scale = _mm_set1_ps(Int16Scale);
+        for (; i + 8 <= sampleCount; i += 8) {
+            __m128 lo = _mm_mul_ps(_mm_loadu_ps(input + i), scale);
+            __m128 hi = _mm_mul_ps(_mm_loadu_ps(input + i + 4), scale);
+            lo = _mm_add_ps(lo, _mm_add_ps(toNoise(nextRandom(state)), toNoise(nextRandom(state))));
+            hi = _mm_add_ps(hi, _mm_add_ps(toNoise(nextRandom(state)), toNoise(nextRandom(state))));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(ditherState), state);
+    }
+#endif
+
+    for (; i < sampleCount; ++i) {
+        float noise = toNoise(nextRandom(ditherState[0])) + toNoise(nextRandom(ditherState[0]));
+        float value = std::nearbyint(input[i] * Int16Scale + noise);
+        output[i] = static_cast<sf::Int16>(std::max(-32768.f, std::min(value, 32767.f)));
+    }
+}
+
+void convertToInt16(const float* input, sf::Int16* output, std::size_t sampleCount) {
+    std::size_t i = 0;
+
+#ifdef WAVEPLEER_SSE2
+    const __m128 scale = _mm_set1_ps(Int16Scale);
+    for (; i + 8 <= sampleCount; i += 8) {
+        const __m128 lo = _mm_mul_ps(_mm_loadu_ps(input + i), scale);
+        const __m128 hi = _mm_mul_ps(_mm_loadu_ps(input + i + 4), scale);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+    }
+#endif
+
+    for (; i < sampleCount; ++i) {
+        float value = std::nearbyint(input[i] * Int16Scale);
+        output[i] = static_cast<sf::Int16>(std::max(-32768.f, std::min(value, 32767.f)));
+    }
+}
+
+void scaleSamples(float* samples, std::size_t sampleCount, float gain) {
+    std::size_t i = 0;
+
+#ifdef WAVEPLEER_AVX2
+    const __m256 gain256 = _mm256_set1_ps(gain);
+    for (; i + 8 <= sampleCount; i += 8)
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), gain256));
+#endif
+
+#ifdef WAVEPLEER_SSE2
+    const __m128 gain128 = _mm_set1_ps(gain);
+    for (; i + 4 <= sampleCount; i += 4)
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), gain128));
+#endif
+
+    for (; i < sampleCount; ++i)
+        samples[i] *= gain;
+}
+
+void scaleStereo(float* samples, std::size_t frameCount, float leftGain, float rightGain) {
+    std::size_t sampleCount = frameCount * 2;
+    std::size_t i = 0;
+
+#ifdef WAVEPLEER_AVX2
+    const __m256 gain256 = _mm256_setr_ps(leftGain, rightGain, leftGain, rightGain, leftGain, rightGain, leftGain, rightGain);
+    for (; i + 8 <= sampleCount; i += 8)
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), gain256));
+#endif
+
+#ifdef WAVEPLEER_SSE2
+    const __m128 gain128 = _mm_setr_ps(leftGain, rightGain, leftGain, rightGain);
+    for (; i + 4 <= sampleCount; i += 4)
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), gain128));
+#endif
+
+    for (; i < sampleCount; i += 2) {
+        samples[i] *= leftGain;
+        samples[i + 1] *= rightGain;
+    }
+}
+
+float findPeak(const float* samples, std::size_t sampleCount) {
+    std::size_t i = 0;
+    float peak = 0.f;
+
+#ifdef WAVEPLEER_SSE2
+    // Модуль — сброс знакового бита.
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peak128 = _mm_setzero_ps();
+#ifdef WAVEPLEER_AVX2
+    const __m256 mask256 = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 peak256 = _mm256_setzero_ps();
+    for (; i + 8 <= sampleCount; i += 8)
+        peak256 = _mm256_max_ps(peak256, _mm256_and_ps(_mm256_loadu_ps(samples + i), mask256));
+    peak128 = _mm_max_ps(_mm256_castps256_ps128(peak256), _mm256_extractf128_ps(peak256, 1));
+#endif
+    for (; i + 4 <= sampleCount; i += 4)
+        peak128 = _mm_max_ps(peak128, _mm_and_ps(_mm_loadu_ps(samples + i), mask));
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, peak128);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+
+    for (; i < sampleCount; ++i)
+        peak = std::max(peak, std::fabs(samples[i]));
+    return peak;
+}
+
+void processBiquadCascade(float* samples, std::size_t frameCount, unsigned int channelCount, BiquadSection* sections, std::size_t sectionCount, float& fadePosition, float fadeStep) {
+    if (channelCount != 1 && channelCount != 2)
+        return;
+
+    std::size_t frame = 0;
+    bool isStereo = channelCount == 2;
+
+#ifdef WAVEPLEER_SSE2
+    // Затухающий хвост фильтра уходит в денормализованные числа, которые на x86 считаются в десятки раз медленнее.
+    const unsigned int csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040);
+
+    for (; frame < frameCount; ++frame) {
+        float* values = samples + frame * channelCount;
+        __m128 x = isStereo ? _mm_setr_ps(values[0], values[1], values[0], values[1]) : _mm_set1_ps(values[0]);
+
+        for (std::size_t s = 0; s < sectionCount; ++s) {
+            BiquadSection& section = sections[s];
+            const __m128 z1 = _mm_loadu_ps(section.z1);
+            const __m128 z2 = _mm_loadu_ps(section.z2);
+            const __m128 y = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(section.b0), x), z1);
+            _mm_storeu_ps(section.z1, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(section.b1), x), _mm_mul_ps(_mm_loadu_ps(section.a1), y)), z2));
+            _mm_storeu_ps(section.z2, _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(section.b2), x), _mm_mul_ps(_mm_loadu_ps(section.a2), y)));
+            x = y;
+        }
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, x);
+        for (unsigned int channel = 0; channel < channelCount; ++channel)
+            values[channel] = lanes[channel] + (lanes[2 + channel] - lanes[channel]) * fadePosition;
+        fadePosition = std::min(1.f, fadePosition + fadeStep);
+    }
+
+    _mm_setcsr(csr);
+#endif
+
+    for (; frame < frameCount; ++frame) {
+        float* values = samples + frame * channelCount;
+        float x[4] = { values[0], values[isStereo ? 1 : 0], values[0], values[isStereo ? 1 : 0] };
+
+        for (std::size_t s = 0; s < sectionCount; ++s) {
+            BiquadSection& section = sections[s];
+            for (int lane = 0; lane < 4; ++lane) {
+                float y = section.b0[lane] * x[lane] + section.z1[lane];
+                section.z1[lane] = section.b1[lane] * x[lane] - section.a1[lane] * y + section.z2[lane];
+                section.z2[lane] = section.b2[lane] * x[lane] - section.a2[lane] * y;
+                x[lane] = y;
+            }
+        }
+
+        for (unsigned int channel = 0; channel < channelCount; ++channel)
+            values[channel] = x[channel] + (x[2 + channel] - x[channel]) * fadePosition;
+        fadePosition = std::min(1.f, fadePosition + fadeStep);
+    }
+}
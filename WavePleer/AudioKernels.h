@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <SFML/Config.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// Векторные ядра обработки звука (AVX2 при сборке с /arch:AVX2, иначе SSE2, с запасным скалярным вариантом).
+// Работают с чередующимися (interleaved) сэмплами и не выделяют память.
+
+// Смешивает уходящий и входящий треки с линейным изменением громкости.
+// Громкость входящего трека в кадре n равна fadePosition + fadeStep * n, уходящего — единица минус она.
+// output может совпадать с outgoing.
+void mixCrossfade(const sf::Int16* outgoing, const sf::Int16* incoming, sf::Int16* output, std::size_t sampleCount, unsigned int channelCount, float fadePosition, float fadeStep);
+
+// Умножает сэмплы Int16 на gain с округлением и насыщением.
+void scaleInt16(sf::Int16* samples, std::size_t sampleCount, float gain);
+
+// Переводит Int16 в float в диапазоне [-1, 1).
+void convertToFloat(const sf::Int16* input, float* output, std::size_t sampleCount);
+
+// Переводит float обратно в Int16 с треугольным (TPDF) дизерингом в ±1 младший разряд и насыщением.
+// ditherState — 8 ненулевых слов состояния генератора, которые ядро обновляет.
+void convertToInt16Dithered(const float* input, sf::Int16* output, std::size_t sampleCount, std::uint32_t* ditherState);
+
+// Переводит float обратно в Int16 с округлением и насыщением.
+void convertToInt16(const float* input, sf::Int16* output, std::size_t sampleCount);
+
+// Умножает все сэмплы на gain.
+void scaleSamples(float* samples, std::size_t sampleCount, float gain);
+
+// Умножает левый и правый каналы стерео на свои коэффициенты.
+void scaleStereo(float* samples, std::size_t frameCount, float leftGain, float rightGain);
+
+// Наибольшая амплитуда в блоке.
+float findPeak(const float* samples, std::size_t sampleCount);
+
+// Секция биквада (транспонированная прямая форма II) на четыре полосы SIMD.
+// Полосы 0 и 1 — левый и правый каналы с прежними коэффициентами, 2 и 3 — с новыми.
+struct BiquadSection {
+    float b0[4], b1[4], b2[4], a1[4], a2[4];
+    float z1[4], z2[4];
+};
+
+// Пропускает моно или стерео через каскад секций. Выход — смесь прежних и новых полос:
+// доля новых равна fadePosition и растет на fadeStep за кадр до единицы, после чего прежние полосы не влияют на звук.
+void processBiquadCascade(float* samples, std::size_t frameCount, unsigned int channelCount, BiquadSection* sections, std::size_t sectionCount, float& fadePosition, float fadeStep);
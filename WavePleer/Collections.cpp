@@ -0,0 +1,111 @@
+﻿#include "Collections.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace {
+    const char* const DefaultCollections[] = { "Workout", "Focus", "Never play" };
+}
+
+Collections::Collections(const std::string& favoritesPath, const std::string& directory)
+    : m_favoritesPath(favoritesPath), m_directory(directory) {
+}
+
+void Collections::load() {
+    m_collections.clear();
+
+    // Избранное остается в своем файле: существующий favorites.txt становится коллекцией без переноса.
+    open("Favorites", m_favoritesPath);
+
+    std::error_code error;
+    if (!std::filesystem::exists(m_directory, error)) {
+        std::filesystem::create_directories(m_directory, error);
+        if (error) {
+            std::cerr << "Failed to create collections directory: " << m_directory << std::endl;
+            return;
+        }
+        for (const char* name : DefaultCollections)
+            std::ofstream((std::filesystem::path(m_directory) / (std::string(name) + ".txt")).string());
+    }
+
+    std::vector<std::filesystem::path> paths;
+    for (std::filesystem::directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() == ".txt")
+            paths.push_back(it->path());
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const auto& path : paths)
+        open(path.stem().string(), path.string());
+}
+
+std::size_t Collections::getCount() const {
+    return m_collections.size();
+}
+
+const std::string& Collections::getName(std::size_t collection) const {
+    return m_collections[collection]->name;
+}
+
+int Collections::find(const std::string& name) const {
+    for (std::size_t i = 0; i < m_collections.size(); ++i) {
+        if (m_collections[i]->name == name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool Collections::contains(std::size_t collection, std::uint64_t track) const {
+    const auto& members = m_collections[collection]->members;
+    return members.find(track) != members.end();
+}
+
+bool Collections::toggle(std::size_t collection, int index, const Library& library) {
+    Collection& target = *m_collections[collection];
+    std::uint64_t track = library.getInfo(index).id;
+    if (track == 0)
+        return false;
+
+    if (target.members.insert(track).second) {
+        target.journal->add(track);
+        target.tracks.add(static_cast<std::uint32_t>(index));
+        return true;
+    }
+
+    target.members.erase(track);
+    target.journal->remove(track);
+    target.tracks.remove(static_cast<std::uint32_t>(index));
+    return false;
+}
+
+const TrackBitmap& Collections::getTracks(std::size_t collection) const {
+    return m_collections[collection]->tracks;
+}
+
+void Collections::update(const Library& library) {
+    for (auto& collection : m_collections) {
+        // Индексы собираются и сортируются заранее: тогда каждый add дописывает в конец контейнера.
+        m_scratch.clear();
+        for (std::uint64_t track : collection->members) {
+            int index = library.findById(track);
+            if (index >= 0)
+                m_scratch.push_back(static_cast<std::uint32_t>(index));
+        }
+        std::sort(m_scratch.begin(), m_scratch.end());
+
+        collection->tracks.clear();
+        for (std::uint32_t index : m_scratch)
+            collection->tracks.add(index);
+    }
+}
+
+void Collections::open(const std::string& name, const std::string& path) {
+    auto collection = std::make_unique<Collection>();
+    collection->name = name;
+    collection->journal = std::make_unique<FavoritesJournal>(path);
+    collection->journal->load(collection->members);
+    m_collections.push_back(std::move(collection));
+}
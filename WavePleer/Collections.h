@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "FavoritesJournal.h"
+#include "Library.h"
+#include "TrackBitmap.h"
+
+// Именованные коллекции треков: избранное и пользовательские списки ("Workout", "Focus", ...).
+// Состав коллекции хранится по идентификаторам содержимого (TrackId) в снимке с журналом
+// (см. FavoritesJournal), поэтому в ней остаются и треки, которых сейчас нет в медиатеке.
+// Для запросов каждая коллекция дополнительно держит TrackBitmap индексов медиатеки: выборки
+// вроде "Focus без Never play" — это getTracks(focus) - getTracks(neverPlay).
+// Коллекция 0 — избранное в прежнем файле favorites.txt, остальные — файлы *.txt каталога коллекций.
+class Collections {
+public:
+    static const std::size_t Favorites = 0;
+
+    Collections(const std::string& favoritesPath, const std::string& directory);
+
+    // Читает коллекции. Если каталога коллекций еще нет, создает его со списками по умолчанию.
+    void load();
+
+    std::size_t getCount() const;
+    const std::string& getName(std::size_t collection) const;
+
+    // Индекс коллекции по имени или -1.
+    int find(const std::string& name) const;
+
+    bool contains(std::size_t collection, std::uint64_t track) const;
+
+    // Добавляет трек медиатеки в коллекцию или убирает его оттуда.
+    // Возвращает true, если трек теперь в коллекции. Трек без идентификатора не добавляется.
+    bool toggle(std::size_t collection, int index, const Library& library);
+
+    // Треки коллекции, которые есть в медиатеке, по их индексам.
+    const TrackBitmap& getTracks(std::size_t collection) const;
+
+    // Пересобирает битовые карты после изменения медиатеки.
+    void update(const Library& library);
+
+private:
+    struct Collection {
+        std::string                       name;
+        std::unordered_set<std::uint64_t> members;
+        std::unique_ptr<FavoritesJournal> journal;
+        TrackBitmap                       tracks;
+    };
+
+    void open(const std::string& name, const std::string& path);
+
+    std::string                              m_favoritesPath;
+    std::string                              m_directory;
+    std::vector<std::unique_ptr<Collection>> m_collections;
+    std::vector<std::uint32_t>               m_scratch;   // индексы при пересборке
+};
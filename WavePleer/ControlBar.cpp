@@ -0,0 +1,161 @@
+﻿#include "ControlBar.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float IndicatorRadius = 10.f;
+
+    // Промежуток между картинками атласа, чтобы соседние не попадали в выборку на краях.
+    const unsigned int AtlasPadding = 2;
+
+    // Сторона белого квадрата. Ползунок берет из него только центральный пиксель.
+    const unsigned int SolidSize = 4;
+
+    const sf::Color ControlColor = sf::Color::Black;
+}
+
+ControlBar::ControlBar()
+    : m_vertices(sf::Triangles) {
+}
+
+bool ControlBar::loadIcons(const std::vector<std::string>& paths) {
+    std::vector<sf::Image> icons(paths.size());
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        if (!icons[i].loadFromFile(paths[i]))
+            return false;
+    }
+
+    // Иконки, квадрат и круг укладываются в один ряд.
+    unsigned int discSize = static_cast<unsigned int>(IndicatorRadius * 2);
+    unsigned int width = SolidSize + AtlasPadding + discSize;
+    unsigned int height = std::max(SolidSize, discSize);
+    for (const auto& icon : icons) {
+        width += AtlasPadding + icon.getSize().x;
+        height = std::max(height, icon.getSize().y);
+    }
+
+    sf::Image atlas;
+    atlas.create(width, height, sf::Color::Transparent);
+
+    unsigned int x = 0;
+    m_iconRects.clear();
+    for (const auto& icon : icons) {
+        atlas.copy(icon, x, 0);
+        m_iconRects.push_back(sf::FloatRect(static_cast<float>(x), 0.f, static_cast<float>(icon.getSize().x), static_cast<float>(icon.getSize().y)));
+        x += icon.getSize().x + AtlasPadding;
+    }
+
+    for (unsigned int py = 0; py < SolidSize; ++py) {
+        for (unsigned int px = 0; px < SolidSize; ++px)
+            atlas.setPixel(x + px, py, sf::Color::White);
+    }
+    m_solidRect = sf::FloatRect(x + SolidSize / 2.f, SolidSize / 2.f, 0.f, 0.f);
+    x += SolidSize + AtlasPadding;
+
+    // Круг со сглаженным краем: покрытие пикселя оценивается по расстоянию от центра.
+    for (unsigned int py = 0; py < discSize; ++py) {
+        for (unsigned int px = 0; px < discSize; ++px) {
+            float dx = px + 0.5f - IndicatorRadius;
+            float dy = py + 0.5f - IndicatorRadius;
+            float coverage = std::max(0.f, std::min(1.f, IndicatorRadius + 0.5f - std::sqrt(dx * dx + dy * dy)));
+            atlas.setPixel(x + px, py, sf::Color(255, 255, 255, static_cast<sf::Uint8>(coverage * 255)));
+        }
+    }
+    m_discRect = sf::FloatRect(static_cast<float>(x), 0.f, static_cast<float>(discSize), static_cast<float>(discSize));
+
+    if (!m_atlas.loadFromImage(atlas))
+        return false;
+
+    m_vertices.resize((icons.size() + 2) * 6);
+    for (std::size_t i = 0; i < icons.size(); ++i)
+        setQuad(i, sf::FloatRect(0.f, 0.f, m_iconRects[i].width, m_iconRects[i].height), m_iconRects[i], sf::Color::White);
+    setSlider(sf::Vector2f(), sf::Vector2f());
+    setIndicatorPosition(sf::Vector2f());
+    return true;
+}
+
+std::size_t ControlBar::getButtonCount() const {
+    return m_iconRects.size();
+}
+
+void ControlBar::setButtonPosition(std::size_t button, sf::Vector2f position) {
+    sf::Color color = m_vertices[button * 6].color;
+    setQuad(button, sf::FloatRect(position.x, position.y, m_iconRects[button].width, m_iconRects[button].height), m_iconRects[button], color);
+}
+
+sf::Vector2f ControlBar::getButtonPosition(std::size_t button) const {
+    return m_vertices[button * 6].position;
+}
+
+sf::FloatRect ControlBar::getButtonBounds(std::size_t button) const {
+    return getQuadBounds(button);
+}
+
+void ControlBar::setButtonAlpha(std::size_t button, sf::Uint8 alpha) {
+    for (std::size_t i = button * 6; i < button * 6 + 6; ++i)
+        m_vertices[i].color.a = alpha;
+}
+
+sf::Uint8 ControlBar::getButtonAlpha(std::size_t button) const {
+    return m_vertices[button * 6].color.a;
+}
+
+void ControlBar::setSlider(sf::Vector2f position, sf::Vector2f size) {
+    setQuad(getSliderQuad(), sf::FloatRect(position, size), m_solidRect, ControlColor);
+}
+
+sf::FloatRect ControlBar::getSliderBounds() const {
+    return getQuadBounds(getSliderQuad());
+}
+
+void ControlBar::setIndicatorPosition(sf::Vector2f center) {
+    m_indicatorCenter = center;
+    sf::FloatRect rect(center.x - IndicatorRadius, center.y - IndicatorRadius, IndicatorRadius * 2, IndicatorRadius * 2);
+    setQuad(getIndicatorQuad(), rect, m_discRect, ControlColor);
+}
+
+sf::Vector2f ControlBar::getIndicatorPosition() const {
+    return m_indicatorCenter;
+}
+
+sf::FloatRect ControlBar::getIndicatorBounds() const {
+    return getQuadBounds(getIndicatorQuad());
+}
+
+sf::FloatRect ControlBar::getGlobalBounds() const {
+    return m_vertices.getBounds();
+}
+
+void ControlBar::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+    states.texture = &m_atlas;
+    target.draw(m_vertices, states);
+}
+
+void ControlBar::setQuad(std::size_t quad, const sf::FloatRect& rect, const sf::FloatRect& textureRect, sf::Color color) {
+    sf::Vertex* vertices = &m_vertices[quad * 6];
+    float right = rect.left + rect.width;
+    float bottom = rect.top + rect.height;
+    float textureRight = textureRect.left + textureRect.width;
+    float textureBottom = textureRect.top + textureRect.height;
+
+    vertices[0] = sf::Vertex(sf::Vector2f(rect.left, rect.top), color, sf::Vector2f(textureRect.left, textureRect.top));
+    vertices[1] = sf::Vertex(sf::Vector2f(right, rect.top), color, sf::Vector2f(textureRight, textureRect.top));
+    vertices[2] = sf::Vertex(sf::Vector2f(rect.left, bottom), color, sf::Vector2f(textureRect.left, textureBottom));
+    vertices[3] = vertices[2];
+    vertices[4] = vertices[1];
+    vertices[5] = sf::Vertex(sf::Vector2f(right, bottom), color, sf::Vector2f(textureRight, textureBottom));
+}
+
+sf::FloatRect ControlBar::getQuadBounds(std::size_t quad) const {
+    const sf::Vertex* vertices = &m_vertices[quad * 6];
+    return sf::FloatRect(vertices[0].position, vertices[5].position - vertices[0].position);
+}
+
+std::size_t ControlBar::getSliderQuad() const {
+    return m_iconRects.size();
+}
+
+std::size_t ControlBar::getIndicatorQuad() const {
+    return m_iconRects.size() + 1;
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+// Панель управления: кнопки, ползунок громкости и его индикатор.
+// Иконки кнопок при загрузке упаковываются в один атлас вместе с белым квадратом для ползунка
+// и кругом для индикатора, поэтому вся панель — один массив вершин и один вызов отрисовки
+// без переключения текстур. Прозрачность кнопок задается цветом их вершин.
+class ControlBar : public sf::Drawable {
+public:
+    ControlBar();
+
+    // Загружает иконки кнопок и собирает атлас. Возвращает false, если иконку не удалось загрузить.
+    bool loadIcons(const std::vector<std::string>& paths);
+
+    std::size_t getButtonCount() const;
+
+    // Положение левого верхнего угла кнопки. Кнопка имеет размер своей иконки.
+    void setButtonPosition(std::size_t button, sf::Vector2f position);
+    sf::Vector2f getButtonPosition(std::size_t button) const;
+    sf::FloatRect getButtonBounds(std::size_t button) const;
+
+    // Меняет прозрачность кнопки (0 — прозрачная, 255 — непрозрачная).
+    void setButtonAlpha(std::size_t button, sf::Uint8 alpha);
+    sf::Uint8 getButtonAlpha(std::size_t button) const;
+
+    void setSlider(sf::Vector2f position, sf::Vector2f size);
+    sf::FloatRect getSliderBounds() const;
+
+    // Положение центра индикатора громкости.
+    void setIndicatorPosition(sf::Vector2f center);
+    sf::Vector2f getIndicatorPosition() const;
+    sf::FloatRect getIndicatorBounds() const;
+
+    // Границы всей панели (для Scene).
+    sf::FloatRect getGlobalBounds() const;
+
+protected:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+
+private:
+    // Записывает прямоугольник из двух треугольников в вершины quad.
+    void setQuad(std::size_t quad, const sf::FloatRect& rect, const sf::FloatRect& textureRect, sf::Color color);
+
+    sf::FloatRect getQuadBounds(std::size_t quad) const;
+
+    std::size_t getSliderQuad() const;
+    std::size_t getIndicatorQuad() const;
+
+    sf::Texture                m_atlas;
+    std::vector<sf::FloatRect> m_iconRects;       // иконки кнопок в атласе
+    sf::FloatRect              m_solidRect;       // белый квадрат для ползунка
+    sf::FloatRect              m_discRect;        // белый круг для индикатора
+    sf::VertexArray            m_vertices;        // по шесть вершин на кнопку, ползунок и индикатор
+    sf::Vector2f               m_indicatorCenter;
+};
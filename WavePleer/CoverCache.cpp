@@ -0,0 +1,326 @@
+﻿#include "CoverCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <system_error>
+
+#include "MappedFile.h"
+#include "TagReader.h"
+
+namespace {
+    // Сколько треков помнят свою обложку. Запись занимает несколько десятков байт.
+    const std::size_t TrackMemory = 1024;
+
+    // Предельный объем каталога эскизов.
+    const std::uint64_t ThumbnailDiskBudget = 256 * 1024 * 1024;
+
+    // FNV-1a по сжатым данным картинки: одинаковые обложки альбома дают одинаковый хеш.
+    std::uint64_t hashData(const unsigned char* data, std::size_t size) {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (std::size_t i = 0; i < size; ++i) {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        // Ноль означает «обложки нет».
+        return hash != 0 ? hash : 1;
+    }
+}
+
+CoverCache::CoverCache(const std::string& thumbnailDirectory, const std::string& placeholderDirectory, unsigned int coverSize, std::size_t budget)
+    : m_budget(budget), m_size(0), m_currentTrack(-1), m_currentHash(0), m_texture(nullptr), m_isChanged(false),
+      m_running(true), m_hasCurrent(false), m_hasPrefetch(false), m_isLoading(false), m_thumbnails(thumbnailDirectory, coverSize, ThumbnailDiskBudget),
+      m_placeholderDirectory(placeholderDirectory), m_isPlaceholderListed(false) {
+    m_thread = std::thread(&CoverCache::run, this);
+}
+
+CoverCache::~CoverCache() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+void CoverCache::request(int trackIndex, const std::string& path) {
+    m_currentTrack = trackIndex;
+    m_currentPath = path;
+
+    // Обложка трека уже известна: переключаемся сразу.
+    auto found = m_trackCovers.find(trackIndex);
+    if (found != m_trackCovers.end()) {
+        const sf::Texture* texture = found->second != 0 ? touch(found->second) : nullptr;
+        if (found->second == 0 || texture) {
+            m_texture = texture;
+            m_currentHash = found->second;
+            m_isChanged = true;
+            return;
+        }
+    }
+
+    enqueue(true, trackIndex, path);
+}
+
+void CoverCache::prefetch(int trackIndex, const std::string& path) {
+    if (m_trackCovers.find(trackIndex) == m_trackCovers.end())
+        enqueue(false, trackIndex, path);
+}
+
+bool CoverCache::update(sf::Time budget) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& result : m_results)
+            m_pending.push_back(std::move(result));
+        m_results.clear();
+    }
+
+    bool changed = m_isChanged;
+    m_isChanged = false;
+
+    // Обложка текущего трека загружается первой.
+    auto current = std::find_if(m_pending.begin(), m_pending.end(), [this](const Result& result) {
+        return result.trackIndex == m_currentTrack;
+    });
+    if (current != m_pending.end())
+        std::rotate(m_pending.begin(), current, current + 1);
+
+    // Загрузка текстуры занимает время кадра, поэтому остальные картинки подождут следующих кадров.
+    sf::Clock clock;
+    bool isFirst = true;
+    while (!m_pending.empty() && (isFirst || clock.getElapsedTime() < budget)) {
+        isFirst = false;
+        Result result = std::move(m_pending.front());
+        m_pending.pop_front();
+
+        const sf::Texture* texture = nullptr;
+        if (result.image) {
+            texture = insert(result.hash, *result.image);
+            if (!texture)
+                result.hash = 0;    // картинку не удалось загрузить в видеопамять
+        }
+        else if (result.hash != 0) {
+            texture = touch(result.hash);
+            if (!texture) {
+                // Текстуру вытеснили, пока искалась картинка: для текущего трека декодируем ее заново.
+                if (result.trackIndex == m_currentTrack)
+                    enqueue(true, m_currentTrack, m_currentPath);
+                continue;
+            }
+        }
+
+        rememberTrack(result.trackIndex, result.hash);
+        if (result.trackIndex == m_currentTrack) {
+            m_texture = texture;
+            m_currentHash = result.hash;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+const sf::Texture* CoverCache::getTexture() const {
+    return m_texture;
+}
+
+bool CoverCache::isBusy() const {
+    if (!m_pending.empty())
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hasCurrent || m_hasPrefetch || m_isLoading || !m_results.empty();
+}
+
+void CoverCache::run() {
+    // Чистим каталог эскизов здесь, а не в конструкторе, чтобы не задерживать первый кадр.
+    m_thumbnails.prune();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_condition.wait(lock, [this] { return !m_running || m_hasCurrent || m_hasPrefetch; });
+        if (!m_running)
+            break;
+
+        // Обложка текущего трека важнее заранее запрошенной.
+        Request request;
+        if (m_hasCurrent) {
+            request = std::move(m_current);
+            m_hasCurrent = false;
+        }
+        else {
+            request = std::move(m_prefetch);
+            m_hasPrefetch = false;
+        }
+        m_isLoading = true;
+        lock.unlock();
+
+        Result result = load(request);
+
+        lock.lock();
+        m_results.push_back(std::move(result));
+        m_isLoading = false;
+    }
+}
+
+CoverCache::Result CoverCache::load(const Request& request) {
+    Result result = { request.trackIndex, 0, nullptr };
+
+    // Встроенная обложка отображается в память прямо из аудиофайла, иначе берем картинку альбома целиком.
+    std::string source = request.path;
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    if (!TagReader::findPicture(request.path, offset, size) && !findCoverFile(request.path, source) &&
+        !findPlaceholder(request.trackIndex, source))
+        return result;
+
+    std::error_code error;
+    std::int64_t time = static_cast<std::int64_t>(std::filesystem::last_write_time(source, error).time_since_epoch().count());
+    if (error)
+        return result;
+
+    // Эскиз уже есть: исходную картинку не читаем и не декодируем.
+    auto image = std::make_unique<sf::Image>();
+    if (m_thumbnails.load(source, offset, size, time, result.hash, *image)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_resident.count(result.hash))
+            result.image = std::move(image);
+        return result;
+    }
+
+    MappedFile file;
+    if (!file.open(source, static_cast<std::size_t>(offset), static_cast<std::size_t>(size)))
+        return result;
+
+    result.hash = hashData(file.getData(), file.getSize());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_resident.count(result.hash))
+            return result;
+    }
+
+    if (image->loadFromMemory(file.getData(), file.getSize()))
+        result.image = std::make_unique<sf::Image>(m_thumbnails.save(source, offset, size, time, result.hash, *image));
+    else
+        result.hash = 0;
+    return result;
+}
+
+bool CoverCache::findCoverFile(const std::string& trackPath, std::string& coverPath) {
+    // Имена по убыванию предпочтения, без учета регистра.
+    static const char* const names[] = {
+        "cover.jpg", "folder.jpg", "front.jpg", "cover.jpeg", "folder.jpeg", "front.jpeg", "cover.png", "folder.png", "front.png"
+    };
+    const std::size_t nameCount = sizeof(names) / sizeof(names[0]);
+
+    std::size_t best = nameCount;
+    std::error_code error;
+    std::filesystem::directory_iterator it(std::filesystem::path(trackPath).parent_path(), error);
+    std::filesystem::directory_iterator end;
+    for (; !error && it != end; it.increment(error)) {
+        std::string name = it->path().filename().string();
+        for (auto& c : name)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+        for (std::size_t i = 0; i < best; ++i) {
+            if (name == names[i]) {
+                best = i;
+                coverPath = it->path().string();
+                break;
+            }
+        }
+    }
+
+    return best < nameCount;
+}
+
+bool CoverCache::findPlaceholder(int trackIndex, std::string& path) {
+    if (!m_isPlaceholderListed) {
+        m_isPlaceholderListed = true;
+
+        std::error_code error;
+        std::filesystem::directory_iterator it(m_placeholderDirectory, error);
+        std::filesystem::directory_iterator end;
+        for (; !error && it != end; it.increment(error)) {
+            std::string extension = it->path().extension().string();
+            for (auto& c : extension)
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            if (extension == ".png" || extension == ".jpg" || extension == ".jpeg")
+                m_placeholders.push_back(it->path().string());
+        }
+        std::sort(m_placeholders.begin(), m_placeholders.end());
+    }
+
+    if (m_placeholders.empty() || trackIndex < 0)
+        return false;
+    path = m_placeholders[trackIndex % m_placeholders.size()];
+    return true;
+}
+
+const sf::Texture* CoverCache::touch(std::uint64_t hash) {
+    auto found = m_lookup.find(hash);
+    if (found == m_lookup.end())
+        return nullptr;
+
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    return &found->second->texture;
+}
+
+const sf::Texture* CoverCache::insert(std::uint64_t hash, const sf::Image& image) {
+    // Картинку могли декодировать дважды (текущий и заранее запрошенный трек одного альбома).
+    if (const sf::Texture* texture = touch(hash))
+        return texture;
+
+    m_entries.emplace_front();
+    Entry& entry = m_entries.front();
+    if (!entry.texture.loadFromImage(image)) {
+        m_entries.pop_front();
+        return nullptr;
+    }
+    entry.texture.setSmooth(true);
+    entry.hash = hash;
+    entry.size = static_cast<std::size_t>(image.getSize().x) * image.getSize().y * 4;
+    m_lookup.emplace(hash, m_entries.begin());
+    m_size += entry.size;
+
+    // Вытесняем самые старые текстуры, кроме новой и показываемой сейчас.
+    std::vector<std::uint64_t> evicted;
+    auto it = m_entries.end();
+    while (m_size > m_budget && --it != m_entries.begin()) {
+        if (it->hash == m_currentHash)
+            continue;
+
+        m_size -= it->size;
+        evicted.push_back(it->hash);
+        m_lookup.erase(it->hash);
+        it = m_entries.erase(it);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_resident.insert(hash);
+    for (std::uint64_t old : evicted)
+        m_resident.erase(old);
+    return &entry.texture;
+}
+
+void CoverCache::rememberTrack(int trackIndex, std::uint64_t hash) {
+    if (m_trackCovers.find(trackIndex) == m_trackCovers.end())
+        m_trackOrder.push_back(trackIndex);
+    m_trackCovers[trackIndex] = hash;
+
+    while (m_trackOrder.size() > TrackMemory) {
+        m_trackCovers.erase(m_trackOrder.front());
+        m_trackOrder.pop_front();
+    }
+}
+
+void CoverCache::enqueue(bool isCurrent, int trackIndex, const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Request& request = isCurrent ? m_current : m_prefetch;
+        request.trackIndex = trackIndex;
+        request.path = path;
+        (isCurrent ? m_hasCurrent : m_hasPrefetch) = true;
+    }
+    m_condition.notify_one();
+}
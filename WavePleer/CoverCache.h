@@ -0,0 +1,130 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "ThumbnailCache.h"
+
+// Обложки треков.
+// Обложка берется из тегов трека (ID3v2 APIC, FLAC PICTURE), а если ее там нет — из файла
+// folder.jpg, cover.jpg или front.jpg рядом с треком. Картинка ищется и декодируется в sf::Image
+// в фоновом потоке, а в текстуру загружается в UI-потоке (update).
+// Декодированная картинка уменьшается до размера, в котором ее показывает интерфейс, и сохраняется
+// в дисковом кэше эскизов: в следующий раз обложка читается оттуда без декодирования.
+// Трек без обложки получает одно из изображений каталога заглушек, всегда одно и то же для трека.
+// Заглушки тоже загружаются только по запросу.
+//
+// Текстуры хранятся в LRU-кэше с ограничением по объему. Ключ — хеш сжатых данных картинки,
+// поэтому треки одного альбома используют одну текстуру, а память не растет вместе с медиатекой.
+// Все методы, кроме конструктора и деструктора, вызываются из UI-потока.
+class CoverCache {
+public:
+    // thumbnailDirectory — каталог эскизов, placeholderDirectory — каталог заглушек,
+    // coverSize — сторона обложки в интерфейсе, budget — предельный объем текстур в байтах.
+    CoverCache(const std::string& thumbnailDirectory, const std::string& placeholderDirectory, unsigned int coverSize, std::size_t budget = 64 * 1024 * 1024);
+    ~CoverCache();
+
+    CoverCache(const CoverCache&) = delete;
+    CoverCache& operator=(const CoverCache&) = delete;
+
+    // Запрашивает обложку трека, который станет текущим. Текущая обложка остается до готовности новой.
+    void request(int trackIndex, const std::string& path);
+
+    // Заранее готовит обложку трека (например, следующего), не меняя текущую.
+    void prefetch(int trackIndex, const std::string& path);
+
+    // Загружает готовые картинки в текстуры, пока не истечет budget (но хотя бы одну за вызов).
+    // Обложка текущего трека загружается первой. Возвращает true, если она определилась.
+    bool update(sf::Time budget);
+
+    // Текстура обложки текущего трека или nullptr, если обложки у трека нет.
+    const sf::Texture* getTexture() const;
+
+    // Есть ли запросы, которые еще ищутся, декодируются или ждут загрузки в текстуру.
+    bool isBusy() const;
+
+private:
+    struct Request {
+        int         trackIndex;
+        std::string path;
+    };
+
+    struct Result {
+        int                        trackIndex;
+        std::uint64_t              hash;    // 0 — обложки нет
+        std::unique_ptr<sf::Image> image;   // nullptr, если текстура с таким хешем уже есть
+    };
+
+    struct Entry {
+        std::uint64_t hash;
+        std::size_t   size;
+        sf::Texture   texture;
+    };
+
+    void run();
+
+    // Находит обложку и берет ее эскиз с диска. Если эскиза нет, хеширует данные картинки
+    // и декодирует ее, только если такой текстуры еще нет в кэше.
+    Result load(const Request& request);
+
+    // Ищет картинку альбома в каталоге трека.
+    static bool findCoverFile(const std::string& trackPath, std::string& coverPath);
+
+    // Выбирает заглушку для трека. Каталог заглушек читается при первом вызове.
+    bool findPlaceholder(int trackIndex, std::string& path);
+
+    // Текстура по хешу (становится самой свежей) или nullptr.
+    const sf::Texture* touch(std::uint64_t hash);
+
+    // Загружает картинку в новую текстуру, вытесняя самые старые.
+    const sf::Texture* insert(std::uint64_t hash, const sf::Image& image);
+
+    // Запоминает обложку трека, чтобы при возврате к нему не искать ее заново.
+    void rememberTrack(int trackIndex, std::uint64_t hash);
+
+    void enqueue(bool isCurrent, int trackIndex, const std::string& path);
+
+    // Состояние UI-потока.
+    std::size_t                                                 m_budget;
+    std::size_t                                                 m_size;           // объем текстур в кэше
+    std::list<Entry>                                            m_entries;        // от свежих к старым
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator> m_lookup;
+    std::unordered_map<int, std::uint64_t>                      m_trackCovers;    // трек -> хеш обложки
+    std::deque<int>                                             m_trackOrder;     // порядок запоминания треков
+    std::deque<Result>                                          m_pending;        // картинки, ждущие загрузки в текстуры
+    int                                                         m_currentTrack;
+    std::string                                                 m_currentPath;
+    std::uint64_t                                               m_currentHash;    // эту текстуру нельзя вытеснять
+    const sf::Texture*                                          m_texture;
+    bool                                                        m_isChanged;
+
+    // Общее с фоновым потоком состояние.
+    mutable std::mutex                                          m_mutex;
+    std::condition_variable                                     m_condition;
+    bool                                                        m_running;
+    bool                                                        m_hasCurrent;
+    bool                                                        m_hasPrefetch;
+    bool                                                        m_isLoading;      // фоновый поток ищет обложку
+    Request                                                     m_current;
+    Request                                                     m_prefetch;
+    std::vector<Result>                                         m_results;
+    std::unordered_set<std::uint64_t>                           m_resident;       // хеши текстур в кэше
+    // Состояние фонового потока.
+    ThumbnailCache                                              m_thumbnails;
+    std::string                                                 m_placeholderDirectory;
+    std::vector<std::string>                                    m_placeholders;
+    bool                                                        m_isPlaceholderListed;
+    std::thread                                                 m_thread;
+};
@@ -0,0 +1,180 @@
+﻿#include "Decoder.h"
+
+#include <algorithm>
+
+#include "AudioKernels.h"
+
+namespace {
+    // Сколько кадров поток декодера декодирует за раз.
+    const std::size_t DecodeFrames = 4096;
+}
+
+Decoder::Decoder()
+    : m_position(0), m_lag(0), m_primedPosition(0), m_readGeneration(0), m_trackIndex(-1), m_gain(1.f), m_stopping(false),
+      m_seekGeneration(0), m_seekTarget(0), m_ringGeneration(0), m_isFinished(false) {
+}
+
+Decoder::~Decoder() {
+    stop();
+}
+
+bool Decoder::open(const std::string& path, int trackIndex, sf::Time readAhead, float gain) {
+    if (!m_file.openFromFile(path))
+        return false;
+
+    m_trackIndex = trackIndex;
+    m_gain = gain;
+
+    // Декодируем первые полсекунды, пока мы еще в фоновом потоке.
+    std::size_t primeCount = static_cast<std::size_t>(m_file.getSampleRate() / 2) * m_file.getChannelCount();
+    m_primed.resize(primeCount);
+    m_primed.resize(static_cast<std::size_t>(m_file.read(m_primed.data(), primeCount)));
+    if (m_gain != 1.f)
+        scaleInt16(m_primed.data(), m_primed.size(), m_gain);
+
+    // Буфер вмещает хотя бы начало трека и еще один блок декодирования. Размер кратен числу каналов,
+    // чтобы свободная часть до конца буфера всегда состояла из целых кадров.
+    unsigned int channelCount = m_file.getChannelCount();
+    std::size_t frames = static_cast<std::size_t>(std::max(readAhead.asSeconds(), 0.f) * m_file.getSampleRate());
+    frames = std::max(frames, (m_primed.size() + channelCount - 1) / channelCount + DecodeFrames);
+    std::size_t capacity = frames * channelCount;
+    m_ring.allocate(capacity);
+
+    // Полный буфер поток декодера проверяет примерно четыре раза за его длительность.
+    float seconds = static_cast<float>(frames) / m_file.getSampleRate();
+    m_pollInterval = sf::seconds(std::min(seconds / 4, 0.25f));
+
+    // Файл уже стоит сразу за декодированным началом: поток декодера продолжает с этого места.
+    m_thread = std::thread(&Decoder::run, this);
+    return true;
+}
+
+std::size_t Decoder::read(sf::Int16* samples, std::size_t count) {
+    // Начало трека отдаем из декодированной заранее части.
+    std::size_t copied = std::min(count, m_primed.size() - m_primedPosition);
+    std::copy_n(m_primed.begin() + m_primedPosition, copied, samples);
+    m_primedPosition += copied;
+
+    // Буфер читаем, только когда поток декодера заполняет его с нужной позиции.
+    // Флаг читается до буфера: если поток декодера закончил, все его сэмплы уже видны.
+    bool isFinished = false;
+    if (copied < count && m_ringGeneration.load(std::memory_order_acquire) == m_readGeneration) {
+        isFinished = m_isFinished.load(std::memory_order_acquire);
+        m_lag -= m_ring.skip(m_lag);
+        if (m_lag == 0)
+            copied += m_ring.read(samples + copied, count - copied);
+    }
+
+    // Поток декодера отстал: отдаем тишину вместо того, чтобы ждать его.
+    if (copied < count && !isFinished) {
+        std::fill(samples + copied, samples + count, static_cast<sf::Int16>(0));
+        m_lag += count - copied;
+        copied = count;
+    }
+    m_position += copied;
+    return copied;
+}
+
+void Decoder::seek(sf::Time timeOffset) {
+    sf::Uint64 frame = static_cast<sf::Uint64>(timeOffset.asMicroseconds()) * m_file.getSampleRate() / 1000000;
+    sf::Uint64 offset = std::min(frame * m_file.getChannelCount(), m_file.getSampleCount());
+
+    // Позиция внутри декодированного начала: файл продолжается сразу после него.
+    m_position = offset;
+    m_lag = 0;
+    m_primedPosition = static_cast<std::size_t>(std::min<sf::Uint64>(offset, m_primed.size()));
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_seekTarget = std::max<sf::Uint64>(offset, m_primed.size());
+        m_readGeneration = ++m_seekGeneration;
+    }
+    m_condition.notify_one();
+}
+
+std::size_t Decoder::getRemainingSamples() const {
+    // Число сэмплов в заголовке бывает приблизительным, поэтому защищаемся от выхода за конец.
+    sf::Uint64 sampleCount = m_file.getSampleCount();
+    return sampleCount > m_position ? static_cast<std::size_t>(sampleCount - m_position) : 0;
+}
+
+unsigned int Decoder::getChannelCount() const {
+    return m_file.getChannelCount();
+}
+
+unsigned int Decoder::getSampleRate() const {
+    return m_file.getSampleRate();
+}
+
+int Decoder::getTrackIndex() const {
+    return m_trackIndex;
+}
+
+void Decoder::stop() {
+    if (!m_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+void Decoder::run() {
+    const std::size_t blockSize = DecodeFrames * m_file.getChannelCount();
+    sf::Uint32 generation = 0;
+    bool isFinished = false;
+
+    while (true) {
+        // Запрошен переход: читатель не обращается к буферу, пока мы не опубликуем новый номер.
+        sf::Uint64 target = 0;
+        bool isSeekRequested = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+                return;
+            if (m_seekGeneration != generation) {
+                generation = m_seekGeneration;
+                target = m_seekTarget;
+                isSeekRequested = true;
+            }
+        }
+        if (isSeekRequested) {
+            m_ring.reset();
+            m_file.seek(target);
+            isFinished = false;
+            m_isFinished.store(false, std::memory_order_relaxed);
+            m_ringGeneration.store(generation, std::memory_order_release);
+            continue;
+        }
+
+        sf::Int16* data = nullptr;
+        std::size_t writable = m_ring.getWritable(data);
+
+        // Файл дочитан: ждем перехода или остановки.
+        // Места мало: ждем, пока воспроизведение освободит буфер. Читатель нас не будит,
+        // чтобы его сторона оставалась без ожиданий, поэтому просыпаемся по таймеру.
+        if (isFinished || (writable < blockSize && m_ring.getCapacity() - m_ring.getAvailable() < blockSize)) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto isWoken = [this, generation] { return m_stopping || m_seekGeneration != generation; };
+            if (isFinished)
+                m_condition.wait(lock, isWoken);
+            else
+                m_condition.wait_for(lock, std::chrono::microseconds(m_pollInterval.asMicroseconds()), isWoken);
+            continue;
+        }
+
+        // Свободное место переходит через конец буфера: сначала заполняем хвост.
+        std::size_t count = std::min(writable, blockSize);
+
+        std::size_t read = static_cast<std::size_t>(m_file.read(data, count));
+        if (m_gain != 1.f)
+            scaleInt16(data, read, m_gain);
+        m_ring.commit(read);
+        if (read < count) {
+            isFinished = true;
+            m_isFinished.store(true, std::memory_order_release);
+        }
+    }
+}
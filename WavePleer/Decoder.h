@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include <SFML/Audio.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SampleRing.h"
+
+// Декодер одного трека.
+// Открывается в фоновом потоке и заранее декодирует начало трека,
+// чтобы первое чтение на стыке треков не обращалось к диску.
+// Дальше трек декодирует собственный поток декодера: он забегает вперед на несколько секунд
+// в кольцевой буфер, а read в потоке воспроизведения только копирует оттуда готовые сэмплы.
+// Медленное чтение с диска или подкачка страниц задерживают поток декодера, но не воспроизведение.
+// Переход к позиции тоже выполняет поток декодера; начало трека тем временем отдается
+// из заранее декодированной части, поэтому перезапуск трека с начала ничего не ждет.
+class Decoder {
+public:
+    Decoder();
+    ~Decoder();
+
+    Decoder(const Decoder&) = delete;
+    Decoder& operator=(const Decoder&) = delete;
+
+    // Открывает файл, декодирует первые полсекунды звука и запускает поток декодера.
+    // readAhead — на сколько поток декодера забегает вперед воспроизведения.
+    // gain — усиление трека (ReplayGain): сэмплы умножаются на него еще до кольцевого буфера.
+    bool open(const std::string& path, int trackIndex, sf::Time readAhead, float gain = 1.f);
+
+    // Читает до count сэмплов (с учетом каналов). Возвращает число прочитанных сэмплов;
+    // меньше count — только в конце трека. Если поток декодера не успел, недостающее дополняется тишиной,
+    // а опоздавшие сэмплы потом пропускаются: трек не отстает от воспроизведения, и getRemainingSamples
+    // остается точным для наложения. Не ждет, не блокируется и не выделяет память.
+    std::size_t read(sf::Int16* samples, std::size_t count);
+
+    // Переходит к указанной позиции трека. Вызывается, пока поток воспроизведения остановлен.
+    // Не ждет поток декодера и не обращается к файлу: позицию в файле меняет поток декодера.
+    void seek(sf::Time timeOffset);
+
+    // Сколько сэмплов (с учетом каналов) осталось до конца трека.
+    std::size_t getRemainingSamples() const;
+
+    unsigned int getChannelCount() const;
+    unsigned int getSampleRate() const;
+    int getTrackIndex() const;
+
+private:
+    void stop();
+
+    // Цикл потока декодера.
+    void run();
+
+    sf::InputSoundFile      m_file;        // после open принадлежит потоку декодера
+    std::vector<sf::Int16>  m_primed;      // заранее декодированное начало трека
+    SampleRing              m_ring;        // сэмплы после m_primed или после позиции перехода
+
+    // Состояние читателя (поток воспроизведения; seek меняет его, пока воспроизведение остановлено).
+    sf::Uint64              m_position;        // позиция воспроизведения от начала трека, с учетом отданной тишины
+    std::size_t             m_lag;             // сколько сэмплов буфера заменено тишиной и будет пропущено
+    std::size_t             m_primedPosition;  // позиция чтения в m_primed; m_primed.size() — читаем из буфера
+    sf::Uint32              m_readGeneration;  // номер перехода, после которого буфер можно читать
+    int                     m_trackIndex;
+    float                   m_gain;
+    sf::Time                m_pollInterval; // сколько поток декодера спит при полном буфере
+
+    std::thread             m_thread;
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+    bool                    m_stopping;
+    sf::Uint32              m_seekGeneration;  // номер последнего запрошенного перехода
+    sf::Uint64              m_seekTarget;      // с какого сэмпла файла заполнять буфер после перехода
+    std::atomic<sf::Uint32> m_ringGeneration;  // номер перехода, с которого заполнен буфер
+    std::atomic<bool>       m_isFinished;  // поток декодера дошел до конца файла
+};
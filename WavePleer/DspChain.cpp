@@ -0,0 +1,110 @@
+﻿#include "DspChain.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "AudioKernels.h"
+
+namespace {
+    std::uint64_t getNanoseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+}
+
+DspNode::DspNode(const char* name)
+    : m_name(name), m_isEnabled(true), m_nanoseconds(0) {
+}
+
+DspNode::~DspNode() {
+}
+
+const char* DspNode::getName() const {
+    return m_name;
+}
+
+void DspNode::setEnabled(bool isEnabled) {
+    m_isEnabled = isEnabled;
+}
+
+bool DspNode::isEnabled() const {
+    return m_isEnabled;
+}
+
+void DspNode::prepare(unsigned int, unsigned int) {
+}
+
+DspChain::DspChain()
+    : m_channelCount(0), m_sampleRate(0), m_isDitherEnabled(true), m_conversionNanoseconds(0), m_processedFrames(0) {
+    // Генератору дизеринга нужно ненулевое состояние в каждой полосе.
+    for (std::uint32_t i = 0; i < 8; ++i)
+        m_ditherState[i] = 0x9E3779B9u * (i + 1);
+}
+
+void DspChain::prepare(unsigned int channelCount, unsigned int sampleRate, std::size_t maxSampleCount) {
+    m_channelCount = channelCount;
+    m_sampleRate = sampleRate;
+    m_buffer.assign(maxSampleCount, 0.f);
+
+    for (auto& node : m_nodes)
+        node->prepare(channelCount, sampleRate);
+}
+
+void DspChain::process(sf::Int16* samples, std::size_t sampleCount) {
+    if (sampleCount == 0 || m_channelCount == 0)
+        return;
+
+    sampleCount = std::min(sampleCount, m_buffer.size());
+    std::size_t frameCount = sampleCount / m_channelCount;
+
+    auto start = std::chrono::steady_clock::now();
+    convertToFloat(samples, m_buffer.data(), sampleCount);
+    auto conversionTime = getNanoseconds(start, std::chrono::steady_clock::now());
+
+    for (auto& node : m_nodes) {
+        if (!node->isEnabled())
+            continue;
+
+        auto nodeStart = std::chrono::steady_clock::now();
+        node->process(m_buffer.data(), frameCount, m_channelCount);
+        node->m_nanoseconds.fetch_add(getNanoseconds(nodeStart, std::chrono::steady_clock::now()), std::memory_order_relaxed);
+    }
+
+    start = std::chrono::steady_clock::now();
+    if (m_isDitherEnabled.load(std::memory_order_relaxed)) {
+        convertToInt16Dithered(m_buffer.data(), samples, sampleCount, m_ditherState);
+    }
+    else {
+        convertToInt16(m_buffer.data(), samples, sampleCount);
+    }
+    conversionTime += getNanoseconds(start, std::chrono::steady_clock::now());
+
+    m_conversionNanoseconds.fetch_add(conversionTime, std::memory_order_relaxed);
+    m_processedFrames.fetch_add(frameCount, std::memory_order_relaxed);
+}
+
+void DspChain::setDitherEnabled(bool isEnabled) {
+    m_isDitherEnabled = isEnabled;
+}
+
+void DspChain::takeLoads(std::vector<float>& loads) {
+    loads.clear();
+
+    // Длительность обработанного звука в наносекундах.
+    std::uint64_t frames = m_processedFrames.exchange(0);
+    double audioNanoseconds = m_sampleRate > 0 ? static_cast<double>(frames) * 1e9 / m_sampleRate : 0.0;
+
+    for (auto& node : m_nodes) {
+        std::uint64_t nanoseconds = node->m_nanoseconds.exchange(0);
+        loads.push_back(audioNanoseconds > 0.0 ? static_cast<float>(nanoseconds / audioNanoseconds) : 0.f);
+    }
+    std::uint64_t nanoseconds = m_conversionNanoseconds.exchange(0);
+    loads.push_back(audioNanoseconds > 0.0 ? static_cast<float>(nanoseconds / audioNanoseconds) : 0.f);
+}
+
+std::size_t DspChain::getNodeCount() const {
+    return m_nodes.size();
+}
+
+const DspNode& DspChain::getNode(std::size_t node) const {
+    return *m_nodes[node];
+}
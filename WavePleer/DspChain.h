@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include <SFML/Config.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Узел цепочки обработки звука.
+// process вызывается в потоке воспроизведения и не должен ждать, блокироваться и выделять память.
+// Параметры узлов меняются из UI-потока через атомарные поля и читаются один раз за блок.
+class DspNode {
+public:
+    explicit DspNode(const char* name);
+    virtual ~DspNode();
+
+    const char* getName() const;
+
+    // Выключенный узел пропускается целиком.
+    void setEnabled(bool isEnabled);
+    bool isEnabled() const;
+
+    // Готовит узел к новому формату потока (UI-поток, воспроизведение остановлено).
+    virtual void prepare(unsigned int channelCount, unsigned int sampleRate);
+
+    // Обрабатывает frameCount кадров чередующихся сэмплов в диапазоне [-1, 1].
+    virtual void process(float* samples, std::size_t frameCount, unsigned int channelCount) = 0;
+
+private:
+    friend class DspChain;
+
+    const char*                m_name;
+    std::atomic<bool>          m_isEnabled;
+    std::atomic<std::uint64_t> m_nanoseconds;  // время обработки с прошлого DspChain::takeLoads
+};
+
+// Цепочка обработки между декодером и OpenAL.
+// Блок Int16 переводится во float, проходит узлы по порядку и возвращается в Int16 с дизерингом.
+// Состав цепочки задается до начала воспроизведения; во время воспроизведения узлы можно
+// включать, выключать и менять их параметры.
+// Время, потраченное каждым узлом, копится в атомарных счетчиках и доступно UI-потоку как доля
+// реального времени звука.
+class DspChain {
+public:
+    DspChain();
+
+    DspChain(const DspChain&) = delete;
+    DspChain& operator=(const DspChain&) = delete;
+
+    // Добавляет узел в конец цепочки. Вызывается, пока воспроизведение остановлено.
+    template <typename T>
+    T& add(std::unique_ptr<T> node) {
+        T& result = *node;
+        m_nodes.push_back(std::move(node));
+        return result;
+    }
+
+    // Готовит буферы и узлы к формату потока и наибольшему блоку (UI-поток, воспроизведение остановлено).
+    void prepare(unsigned int channelCount, unsigned int sampleRate, std::size_t maxSampleCount);
+
+    // Обрабатывает блок на месте (поток воспроизведения).
+    void process(sf::Int16* samples, std::size_t sampleCount);
+
+    // Дизеринг при переводе обратно в Int16. Без него отсчеты просто округляются.
+    void setDitherEnabled(bool isEnabled);
+
+    // Доля реального времени, которую занял каждый узел с прошлого вызова (последний элемент — перевод форматов).
+    // Вызывается из UI-потока.
+    void takeLoads(std::vector<float>& loads);
+
+    std::size_t getNodeCount() const;
+    const DspNode& getNode(std::size_t node) const;
+
+private:
+    std::vector<std::unique_ptr<DspNode>> m_nodes;
+    std::vector<float>         m_buffer;
+    unsigned int               m_channelCount;
+    unsigned int               m_sampleRate;
+    std::uint32_t              m_ditherState[8];
+    std::atomic<bool>          m_isDitherEnabled;
+    std::atomic<std::uint64_t> m_conversionNanoseconds;
+    std::atomic<std::uint64_t> m_processedFrames;
+};
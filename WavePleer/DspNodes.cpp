@@ -0,0 +1,253 @@
+﻿#include "DspNodes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "AudioKernels.h"
+
+namespace {
+    float fromDecibels(float decibels) {
+        return std::pow(10.f, decibels / 20.f);
+    }
+
+    // Полосы графического эквалайзера через октаву.
+    const float BandFrequencies[EqualizerNode::BandCount] = { 31.f, 62.f, 125.f, 250.f, 500.f, 1000.f, 2000.f, 4000.f, 8000.f, 16000.f };
+    const float OctaveQ = 1.41f;
+    const float MaxBandGainDb = 12.f;
+
+    // Время смешивания прежних и новых коэффициентов.
+    const float FadeTime = 0.02f;
+
+    // Время перехода усиления к новому значению.
+    const float GainRampTime = 0.01f;
+
+    struct EqualizerPreset {
+        const char* name;
+        float       gains[EqualizerNode::BandCount];
+    };
+
+    const EqualizerPreset EqualizerPresets[] = {
+        { "Flat",         { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f } },
+        { "Bass boost",   { 6.f, 5.f, 4.f, 2.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f } },
+        { "Treble boost", { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 2.f, 4.f, 5.f, 6.f } },
+        { "Vocal",        { -3.f, -2.f, -1.f, 1.f, 3.f, 4.f, 3.f, 1.f, 0.f, -1.f } },
+        { "Loudness",     { 5.f, 4.f, 2.f, 0.f, -1.f, -1.f, 0.f, 2.f, 4.f, 5.f } },
+    };
+}
+
+GainNode::GainNode(const char* name)
+    : DspNode(name), m_gain(1.f), m_sampleRate(44100), m_current(1.f), m_rampTarget(1.f), m_rampStep(0.f) {
+}
+
+void GainNode::setGain(float gain) {
+    m_gain = std::max(gain, 0.f);
+}
+
+void GainNode::setGainDb(float decibels) {
+    setGain(fromDecibels(decibels));
+}
+
+float GainNode::getGain() const {
+    return m_gain;
+}
+
+void GainNode::prepare(unsigned int, unsigned int sampleRate) {
+    // Новый поток начинается сразу с целевого усиления.
+    m_sampleRate = sampleRate;
+    m_current = m_rampTarget = m_gain.load(std::memory_order_relaxed);
+    m_rampStep = 0.f;
+}
+
+void GainNode::process(float* samples, std::size_t frameCount, unsigned int channelCount) {
+    // Цель сменилась: переход к ней всегда занимает GainRampTime, откуда бы он ни начинался.
+    float target = m_gain.load(std::memory_order_relaxed);
+    if (target != m_rampTarget) {
+        m_rampTarget = target;
+        m_rampStep = (target - m_current) / std::max(1.f, GainRampTime * m_sampleRate);
+        if (m_rampStep == 0.f)
+            m_current = target;
+    }
+
+    std::size_t frame = 0;
+    for (; frame < frameCount && m_current != m_rampTarget; ++frame) {
+        if (std::fabs(m_rampTarget - m_current) <= std::fabs(m_rampStep))
+            m_current = m_rampTarget;
+        else
+            m_current += m_rampStep;
+
+        float* values = samples + frame * channelCount;
+        for (unsigned int channel = 0; channel < channelCount; ++channel)
+            values[channel] *= m_current;
+    }
+
+    // Остаток блока после перехода — с постоянным усилением.
+    if (frame < frameCount && m_current != 1.f)
+        scaleSamples(samples + frame * channelCount, (frameCount - frame) * channelCount, m_current);
+}
+
+BalanceNode::BalanceNode()
+    : DspNode("Balance"), m_balance(0.f) {
+}
+
+void BalanceNode::setBalance(float balance) {
+    m_balance = std::max(-1.f, std::min(balance, 1.f));
+}
+
+float BalanceNode::getBalance() const {
+    return m_balance;
+}
+
+void BalanceNode::process(float* samples, std::size_t frameCount, unsigned int channelCount) {
+    float balance = m_balance.load(std::memory_order_relaxed);
+    if (channelCount != 2 || balance == 0.f)
+        return;
+
+    // Ослабляется только противоположный канал, чтобы в центре громкость не менялась.
+    scaleStereo(samples, frameCount, std::min(1.f, 1.f - balance), std::min(1.f, 1.f + balance));
+}
+
+LimiterNode::LimiterNode()
+    : DspNode("Limiter"), m_threshold(fromDecibels(-1.f)), m_releaseSeconds(0.1f), m_sampleRate(44100), m_gain(1.f) {
+}
+
+void LimiterNode::setThresholdDb(float decibels) {
+    m_threshold = fromDecibels(std::min(decibels, 0.f));
+}
+
+void LimiterNode::setRelease(float seconds) {
+    m_releaseSeconds = std::max(seconds, 0.001f);
+}
+
+void LimiterNode::prepare(unsigned int, unsigned int sampleRate) {
+    m_sampleRate = sampleRate;
+    m_gain = 1.f;
+}
+
+void LimiterNode::process(float* samples, std::size_t frameCount, unsigned int channelCount) {
+    float threshold = m_threshold.load(std::memory_order_relaxed);
+
+    // Обычный случай: ограничитель отпущен и пики блока ниже порога.
+    if (m_gain == 1.f && findPeak(samples, frameCount * channelCount) <= threshold)
+        return;
+
+    float release = std::exp(-1.f / (m_releaseSeconds.load(std::memory_order_relaxed) * m_sampleRate));
+    for (std::size_t frame = 0; frame < frameCount; ++frame) {
+        float* values = samples + frame * channelCount;
+        float peak = 0.f;
+        for (unsigned int channel = 0; channel < channelCount; ++channel)
+            peak = std::max(peak, std::fabs(values[channel]));
+
+        // Ослабление, при котором кадр ровно на пороге; отпускаем к нему экспоненциально, а сжимаем сразу.
+        float target = peak > threshold ? threshold / peak : 1.f;
+        m_gain = target < m_gain ? target : target + (m_gain - target) * release;
+        if (m_gain > 0.9999f)
+            m_gain = 1.f;
+
+        for (unsigned int channel = 0; channel < channelCount; ++channel)
+            values[channel] *= m_gain;
+    }
+}
+
+EqualizerNode::EqualizerNode()
+    : DspNode("Equalizer"), m_revision(0), m_appliedRevision(0), m_sampleRate(44100), m_sections(), m_fadePosition(1.f), m_fadeStep(0.f) {
+    for (std::size_t band = 0; band < BandCount; ++band) {
+        m_frequencies[band] = BandFrequencies[band];
+        m_gains[band] = 0.f;
+        m_qs[band] = OctaveQ;
+    }
+    computeCoefficients(0);
+    computeCoefficients(2);
+}
+
+void EqualizerNode::setBand(std::size_t band, float frequency, float gainDb, float q) {
+    m_frequencies[band] = std::max(frequency, 10.f);
+    m_gains[band] = std::max(-MaxBandGainDb, std::min(gainDb, MaxBandGainDb));
+    m_qs[band] = std::max(q, 0.1f);
+    m_revision.fetch_add(1, std::memory_order_release);
+}
+
+void EqualizerNode::setBandGain(std::size_t band, float gainDb) {
+    m_gains[band] = std::max(-MaxBandGainDb, std::min(gainDb, MaxBandGainDb));
+    m_revision.fetch_add(1, std::memory_order_release);
+}
+
+float EqualizerNode::getBandGain(std::size_t band) const {
+    return m_gains[band];
+}
+
+std::size_t EqualizerNode::getPresetCount() {
+    return sizeof(EqualizerPresets) / sizeof(EqualizerPresets[0]);
+}
+
+const char* EqualizerNode::getPresetName(std::size_t preset) {
+    return EqualizerPresets[preset].name;
+}
+
+void EqualizerNode::applyPreset(std::size_t preset) {
+    // Одна ревизия на всю настройку, чтобы поток воспроизведения не смешивал ее по частям.
+    for (std::size_t band = 0; band < BandCount; ++band)
+        m_gains[band] = EqualizerPresets[preset].gains[band];
+    m_revision.fetch_add(1, std::memory_order_release);
+}
+
+void EqualizerNode::prepare(unsigned int, unsigned int sampleRate) {
+    m_sampleRate = sampleRate;
+    m_appliedRevision = m_revision.load(std::memory_order_acquire);
+    computeCoefficients(0);
+    computeCoefficients(2);
+    for (auto& section : m_sections) {
+        std::fill(std::begin(section.z1), std::end(section.z1), 0.f);
+        std::fill(std::begin(section.z2), std::end(section.z2), 0.f);
+    }
+    m_fadePosition = 1.f;
+    m_fadeStep = 0.f;
+}
+
+void EqualizerNode::process(float* samples, std::size_t frameCount, unsigned int channelCount) {
+    // Новые параметры применяем, только когда закончилось прошлое смешивание.
+    std::uint32_t revision = m_revision.load(std::memory_order_acquire);
+    if (revision != m_appliedRevision && m_fadePosition >= 1.f) {
+        m_appliedRevision = revision;
+
+        // Текущий каскад вместе с состоянием становится прежним, а новые коэффициенты продолжают с того же состояния.
+        for (auto& section : m_sections) {
+            for (int lane = 0; lane < 2; ++lane) {
+                section.b0[lane] = section.b0[lane + 2];
+                section.b1[lane] = section.b1[lane + 2];
+                section.b2[lane] = section.b2[lane + 2];
+                section.a1[lane] = section.a1[lane + 2];
+                section.a2[lane] = section.a2[lane + 2];
+                section.z1[lane] = section.z1[lane + 2];
+                section.z2[lane] = section.z2[lane + 2];
+            }
+        }
+        computeCoefficients(2);
+        m_fadePosition = 0.f;
+        m_fadeStep = 1.f / (FadeTime * m_sampleRate);
+    }
+
+    processBiquadCascade(samples, frameCount, channelCount, m_sections, BandCount, m_fadePosition, m_fadeStep);
+}
+
+void EqualizerNode::computeCoefficients(int first) {
+    // Пиковый фильтр из RBJ Audio EQ Cookbook.
+    const float pi = 3.14159265f;
+    for (std::size_t band = 0; band < BandCount; ++band) {
+        float frequency = std::min(m_frequencies[band].load(std::memory_order_relaxed), 0.45f * m_sampleRate);
+        float a = std::pow(10.f, m_gains[band].load(std::memory_order_relaxed) / 40.f);
+        float w0 = 2.f * pi * frequency / m_sampleRate;
+        float alpha = std::sin(w0) / (2.f * m_qs[band].load(std::memory_order_relaxed));
+        float cosine = std::cos(w0);
+        float a0 = 1.f + alpha / a;
+
+        BiquadSection& section = m_sections[band];
+        for (int lane = first; lane < first + 2; ++lane) {
+            section.b0[lane] = (1.f + alpha * a) / a0;
+            section.b1[lane] = -2.f * cosine / a0;
+            section.b2[lane] = (1.f - alpha * a) / a0;
+            section.a1[lane] = -2.f * cosine / a0;
+            section.a2[lane] = (1.f - alpha / a) / a0;
+        }
+    }
+}
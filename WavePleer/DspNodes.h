@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "AudioKernels.h"
+#include "DspChain.h"
+
+// Усиление всего сигнала. Одним классом сделаны и предусилитель в начале цепочки, и громкость в ее конце.
+// UI задает целевое усиление, а поток воспроизведения доводит до него текущее линейно за 10 мс,
+// поэтому резкие изменения (перетаскивание ползунка громкости) не дают щелчков.
+class GainNode : public DspNode {
+public:
+    explicit GainNode(const char* name);
+
+    void setGain(float gain);
+    void setGainDb(float decibels);
+    float getGain() const;
+
+    void prepare(unsigned int channelCount, unsigned int sampleRate) override;
+    void process(float* samples, std::size_t frameCount, unsigned int channelCount) override;
+
+private:
+    std::atomic<float> m_gain;         // целевое усиление (UI)
+    unsigned int       m_sampleRate;
+    float              m_current;      // усиление, примененное к последнему кадру (поток воспроизведения)
+    float              m_rampTarget;   // цель, к которой идет текущее изменение
+    float              m_rampStep;     // изменение за кадр
+};
+
+// Баланс стерео: от -1 (только левый канал) до 1 (только правый). Другие форматы не меняются.
+class BalanceNode : public DspNode {
+public:
+    BalanceNode();
+
+    void setBalance(float balance);
+    float getBalance() const;
+
+    void process(float* samples, std::size_t frameCount, unsigned int channelCount) override;
+
+private:
+    std::atomic<float> m_balance;
+};
+
+// Ограничитель пиков: мгновенная атака, экспоненциальное восстановление.
+// Не дает сигналу после предусилителя и эквалайзера выйти за порог и обрезаться при переводе в Int16.
+class LimiterNode : public DspNode {
+public:
+    LimiterNode();
+
+    void setThresholdDb(float decibels);
+    void setRelease(float seconds);
+
+    void prepare(unsigned int channelCount, unsigned int sampleRate) override;
+    void process(float* samples, std::size_t frameCount, unsigned int channelCount) override;
+
+private:
+    std::atomic<float> m_threshold;      // линейный порог
+    std::atomic<float> m_releaseSeconds;
+    unsigned int       m_sampleRate;
+    float              m_gain;           // текущее ослабление (поток воспроизведения)
+};
+
+// Десятиполосный параметрический эквалайзер: каскад пиковых биквадов, моно или стерео.
+// UI-поток меняет параметры полос и увеличивает номер ревизии; поток воспроизведения, заметив
+// новую ревизию, сам пересчитывает коэффициенты и в течение FadeTime смешивает выход прежнего
+// и нового каскадов, чтобы изменение не щелкало. Оба каскада считаются одновременно в четырех
+// полосах SIMD (см. processBiquadCascade), поэтому смешивание ничего не стоит.
+class EqualizerNode : public DspNode {
+public:
+    static const std::size_t BandCount = 10;
+
+    EqualizerNode();
+
+    // Частота в герцах, усиление в децибелах (от -12 до 12) и добротность полосы.
+    void setBand(std::size_t band, float frequency, float gainDb, float q);
+    void setBandGain(std::size_t band, float gainDb);
+    float getBandGain(std::size_t band) const;
+
+    // Готовые настройки усиления полос.
+    static std::size_t getPresetCount();
+    static const char* getPresetName(std::size_t preset);
+    void applyPreset(std::size_t preset);
+
+    void prepare(unsigned int channelCount, unsigned int sampleRate) override;
+    void process(float* samples, std::size_t frameCount, unsigned int channelCount) override;
+
+private:
+    // Записывает коэффициенты текущих параметров в полосы first и first + 1 (поток воспроизведения).
+    void computeCoefficients(int first);
+
+    std::atomic<float>         m_frequencies[BandCount];
+    std::atomic<float>         m_gains[BandCount];
+    std::atomic<float>         m_qs[BandCount];
+    std::atomic<std::uint32_t> m_revision;
+
+    // Состояние потока воспроизведения.
+    std::uint32_t              m_appliedRevision;
+    unsigned int               m_sampleRate;
+    BiquadSection              m_sections[BandCount];
+    float                      m_fadePosition;
+    float                      m_fadeStep;
+};
@@ -0,0 +1,189 @@
+﻿#include "FavoritesJournal.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <system_error>
+
+#include "TrackId.h"
+
+namespace {
+    // Короткий журнал не уплотняется: его чтение при запуске ничего не стоит.
+    const std::size_t MinCompactionRecords = 1024;
+}
+
+FavoritesJournal::FavoritesJournal(const std::string& path)
+    : m_path(path), m_journalPath(path + ".journal"), m_oldJournalPath(path + ".journal.old"),
+      m_records(0), m_retryRecords(0), m_favoriteCount(0), m_isCompacting(false) {
+}
+
+FavoritesJournal::~FavoritesJournal() {
+    if (m_compaction.joinable())
+        m_compaction.join();
+}
+
+void FavoritesJournal::load(std::unordered_set<std::uint64_t>& favorites) {
+    std::size_t legacyCount = 0;
+    if (!readSnapshot(m_path, favorites, legacyCount))
+        std::cerr << "Failed to open favorites file for reading: " << m_path << std::endl;
+
+    // Журнал прерванного уплотнения применяется раньше текущего.
+    replayJournal(m_oldJournalPath, favorites, legacyCount);
+
+    m_records = replayJournal(m_journalPath, favorites, legacyCount);
+    m_favoriteCount = favorites.size();
+
+    m_journal.open(m_journalPath, std::ios::binary | std::ios::app);
+    if (!m_journal.is_open())
+        std::cerr << "Failed to open favorites journal for writing: " << m_journalPath << std::endl;
+
+    // Пути старого формата хешируются при каждом чтении, поэтому снимок пересобирается сразу.
+    compactIfNeeded(legacyCount > 0);
+}
+
+void FavoritesJournal::add(std::uint64_t track) {
+    append('+', track);
+    ++m_favoriteCount;
+}
+
+void FavoritesJournal::remove(std::uint64_t track) {
+    append('-', track);
+    if (m_favoriteCount > 0)
+        --m_favoriteCount;
+}
+
+void FavoritesJournal::append(char operation, std::uint64_t track) {
+    if (!m_journal.is_open())
+        return;
+
+    // Одна запись — одна строка, которая уходит на диск одним вызовом.
+    std::string line = operation + TrackId::format(track) + '\n';
+    m_journal.write(line.data(), static_cast<std::streamsize>(line.size()));
+    m_journal.flush();
+    ++m_records;
+
+    compactIfNeeded();
+}
+
+void FavoritesJournal::compactIfNeeded(bool isForced) {
+    std::size_t threshold = std::max(MinCompactionRecords, m_favoriteCount);
+    if ((!isForced && (m_records < threshold || m_records < m_retryRecords)) || m_isCompacting)
+        return;
+
+    if (m_compaction.joinable())
+        m_compaction.join();
+
+    // Журнал не удалось очистить (прошлое уплотнение не удалось, и .old еще не применен к снимку,
+    // или не удалось переименование): следующая попытка — когда журнал вырастет еще на столько же.
+    // Так неудачи не превращают каждое изменение в перезапись снимка.
+    std::error_code error;
+    if (std::filesystem::exists(m_oldJournalPath, error)) {
+        m_retryRecords = m_records + threshold;
+    }
+    else {
+        m_journal.close();
+        std::filesystem::rename(m_journalPath, m_oldJournalPath, error);
+        m_journal.open(m_journalPath, std::ios::binary | std::ios::app);
+        if (error) {
+            m_retryRecords = m_records + threshold;
+            return;
+        }
+        m_records = 0;
+        m_retryRecords = 0;
+    }
+
+    m_isCompacting = true;
+    m_compaction = std::thread(&FavoritesJournal::compact, this);
+}
+
+void FavoritesJournal::compact() {
+    std::unordered_set<std::uint64_t> favorites;
+    std::size_t legacyCount = 0;
+    readSnapshot(m_path, favorites, legacyCount);
+    replayJournal(m_oldJournalPath, favorites, legacyCount);
+
+    // Пишем во временный файл и переименовываем: снимок всегда либо старый, либо новый целиком.
+    std::string temporaryPath = m_path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (file.is_open()) {
+        for (std::uint64_t track : favorites) {
+            std::string line = TrackId::format(track) + '\n';
+            file.write(line.data(), static_cast<std::streamsize>(line.size()));
+        }
+        file.close();
+    }
+
+    std::error_code error;
+    if (file.fail()) {
+        std::cerr << "Failed to write favorites file: " << temporaryPath << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+    }
+    else {
+        // Журнал удаляется только после замены снимка: сбой между ними лишь повторит его записи.
+        std::filesystem::rename(temporaryPath, m_path, error);
+        if (!error)
+            std::filesystem::remove(m_oldJournalPath, error);
+    }
+
+    m_isCompacting = false;
+}
+
+bool FavoritesJournal::readSnapshot(const std::string& path, std::unordered_set<std::uint64_t>& favorites, std::size_t& legacyCount) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+        std::uint64_t track = parseTrack(line, legacyCount);
+        if (track != 0)
+            favorites.insert(track);
+    }
+    return true;
+}
+
+std::size_t FavoritesJournal::replayJournal(const std::string& path, std::unordered_set<std::uint64_t>& favorites, std::size_t& legacyCount) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return 0;
+
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // Строка без перевода строки в конце файла — оборванная запись, ее пропускаем.
+    std::size_t records = 0;
+    std::size_t begin = 0;
+    std::size_t end;
+    while ((end = data.find('\n', begin)) != std::string::npos) {
+        if (end > begin + 1) {
+            std::string text = data.substr(begin + 1, end - begin - 1);
+            if (!text.empty() && text.back() == '\r')
+                text.pop_back();
+            std::uint64_t track = parseTrack(text, legacyCount);
+            if (track != 0 && data[begin] == '+')
+                favorites.insert(track);
+            else if (track != 0 && data[begin] == '-')
+                favorites.erase(track);
+        }
+        begin = end + 1;
+        ++records;
+    }
+    return records;
+}
+
+std::uint64_t FavoritesJournal::parseTrack(const std::string& text, std::size_t& legacyCount) {
+    std::uint64_t track = TrackId::parse(text);
+    if (track != 0)
+        return track;
+
+    // Старый формат хранил путь к файлу: идентификатор вычисляется по самому файлу.
+    ++legacyCount;
+    track = TrackId::compute(text);
+    if (track == 0)
+        std::cerr << "Favorite track not found, skipped: " << text << std::endl;
+    return track;
+}
@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+// Хранилище избранного и других коллекций (см. Collections): снимок и журнал изменений.
+// Треки хранятся по идентификатору содержимого (TrackId), поэтому избранное переживает
+// переименование и перенос файлов. Снимок (favorites.txt) — идентификаторы по одному в строке
+// (16 шестнадцатеричных цифр). Каждое добавление или удаление дописывается в журнал
+// (favorites.txt.journal) одной строкой "+id" или "-id", поэтому изменение стоит одной короткой
+// записи, сколько бы треков ни было в избранном.
+// Строки старого формата (пути к файлам) переводятся в идентификаторы при загрузке, после чего
+// снимок сразу пересобирается.
+// Когда журнал становится длиннее самого избранного, он уплотняется в фоновом потоке: журнал
+// переименовывается в .old, новые записи идут в новый журнал, а поток собирает снимок с .old
+// во временном файле и атомарно переименовывает его поверх старого. Если уплотнение не удалось,
+// следующая попытка откладывается, пока журнал не вырастет еще на такую же длину.
+// При загрузке читаются снимок, .old (если уплотнение прервалось) и журнал. Оборванная последняя
+// строка журнала (сбой во время записи) пропускается.
+class FavoritesJournal {
+public:
+    explicit FavoritesJournal(const std::string& path);
+    ~FavoritesJournal();
+
+    FavoritesJournal(const FavoritesJournal&) = delete;
+    FavoritesJournal& operator=(const FavoritesJournal&) = delete;
+
+    // Читает избранное и открывает журнал для записи.
+    void load(std::unordered_set<std::uint64_t>& favorites);
+
+    // Записывают изменение в журнал. Трек добавляется, только если его еще нет в избранном, и наоборот.
+    void add(std::uint64_t track);
+    void remove(std::uint64_t track);
+
+private:
+    void append(char operation, std::uint64_t track);
+
+    // Переименовывает журнал и запускает уплотнение, если журнал слишком длинный (или isForced).
+    void compactIfNeeded(bool isForced = false);
+
+    // Собирает новый снимок из старого и журнала .old (фоновый поток).
+    void compact();
+
+    // Читают снимок и журнал; legacyCount увеличивается на число строк старого формата.
+    static bool readSnapshot(const std::string& path, std::unordered_set<std::uint64_t>& favorites, std::size_t& legacyCount);
+    // Применяет записи журнала к избранному. Возвращает число записей.
+    static std::size_t replayJournal(const std::string& path, std::unordered_set<std::uint64_t>& favorites, std::size_t& legacyCount);
+
+    // Идентификатор из строки файла: 16 цифр или путь старого формата. 0 — трек не найден.
+    static std::uint64_t parseTrack(const std::string& text, std::size_t& legacyCount);
+
+    std::string       m_path;
+    std::string       m_journalPath;
+    std::string       m_oldJournalPath;
+    std::ofstream     m_journal;
+    std::size_t       m_records;        // записей в текущем журнале
+    std::size_t       m_retryRecords;   // после неудачного уплотнения следующее — не раньше этого числа записей
+    std::size_t       m_favoriteCount;
+    std::thread       m_compaction;
+    std::atomic<bool> m_isCompacting;
+};
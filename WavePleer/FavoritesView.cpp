@@ -0,0 +1,152 @@
+﻿#include "FavoritesView.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+namespace {
+    const unsigned int CharacterSize = 24;
+    const float Margin = 50.f;
+
+    // Прокрутка одним щелчком колеса, в строках.
+    const float WheelRows = 3.f;
+
+    const std::size_t NoEntry = static_cast<std::size_t>(-1);
+}
+
+FavoritesView::FavoritesView(const sf::Font& font, sf::Vector2f size)
+    : m_font(font), m_size(size), m_scroll(0.f), m_isOpen(false) {
+    m_header.setFont(font);
+    m_header.setFillColor(sf::Color::Black);
+    m_header.setCharacterSize(CharacterSize);
+    m_header.setStyle(sf::Text::Bold);
+    m_header.setPosition(Margin, Margin);
+
+    m_rowHeight = std::max(1.f, font.getLineSpacing(CharacterSize));
+    m_listArea = sf::FloatRect(0.f, Margin + m_rowHeight, size.x, std::max(0.f, size.y - Margin - m_rowHeight));
+
+    // Слотов столько, сколько строк видно одновременно, с учетом двух неполных строк по краям.
+    std::size_t slotCount = static_cast<std::size_t>(std::ceil(m_listArea.height / m_rowHeight)) + 1;
+    m_rows.resize(slotCount);
+    for (auto& row : m_rows) {
+        row.entry = NoEntry;
+        row.text.setFont(font);
+        row.text.setFillColor(sf::Color::Black);
+        row.text.setCharacterSize(CharacterSize);
+        row.text.setStyle(sf::Text::Bold);
+    }
+}
+
+void FavoritesView::open(const sf::String& title, const TrackBitmap& tracks, const Library& library) {
+    m_header.setString(title + ":");
+
+    std::vector<std::uint32_t> indices;
+    tracks.getValues(indices);
+    m_entries.clear();
+    m_entries.reserve(indices.size());
+    for (std::uint32_t index : indices)
+        m_entries.push_back(library.getPath(static_cast<int>(index)));
+    std::sort(m_entries.begin(), m_entries.end());
+
+    for (auto& row : m_rows)
+        row.entry = NoEntry;
+    m_scroll = 0.f;
+    m_isOpen = true;
+    layoutVisibleRows();
+}
+
+void FavoritesView::close() {
+    m_isOpen = false;
+
+    // Снимок избранного нужен только открытому экрану.
+    std::vector<std::string>().swap(m_entries);
+    for (auto& row : m_rows) {
+        row.entry = NoEntry;
+        row.text.setString(sf::String());
+    }
+}
+
+bool FavoritesView::isOpen() const {
+    return m_isOpen;
+}
+
+bool FavoritesView::handleEvent(const sf::Event& event) {
+    if (event.type == sf::Event::MouseWheelScrolled && event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel)
+        return scroll(-event.mouseWheelScroll.delta * WheelRows * m_rowHeight);
+
+    if (event.type != sf::Event::KeyPressed)
+        return false;
+
+    float page = m_listArea.height - m_rowHeight;
+    switch (event.key.code) {
+    case sf::Keyboard::Escape:
+        close();
+        return true;
+    case sf::Keyboard::Up:
+        return scroll(-m_rowHeight);
+    case sf::Keyboard::Down:
+        return scroll(m_rowHeight);
+    case sf::Keyboard::PageUp:
+        return scroll(-page);
+    case sf::Keyboard::PageDown:
+        return scroll(page);
+    case sf::Keyboard::Home:
+        return scroll(-m_scroll);
+    case sf::Keyboard::End:
+        return scroll(m_entries.size() * m_rowHeight);
+    default:
+        return false;
+    }
+}
+
+bool FavoritesView::scroll(float delta) {
+    float maximum = std::max(0.f, m_entries.size() * m_rowHeight - m_listArea.height);
+    float scroll = std::max(0.f, std::min(m_scroll + delta, maximum));
+    if (scroll == m_scroll)
+        return false;
+
+    m_scroll = scroll;
+    layoutVisibleRows();
+    return true;
+}
+
+void FavoritesView::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+    target.draw(m_header, states);
+
+    // Строки обрезаются по области списка, чтобы не наезжать на заголовок.
+    sf::View previous = target.getView();
+    sf::View list(m_listArea);
+    list.setViewport(sf::FloatRect(m_listArea.left / m_size.x, m_listArea.top / m_size.y, m_listArea.width / m_size.x, m_listArea.height / m_size.y));
+    target.setView(list);
+
+    sf::RenderStates rowStates = states;
+    rowStates.transform.translate(0.f, -m_scroll);
+    std::size_t end = getVisibleEnd();
+    for (std::size_t entry = getFirstVisible(); entry < end; ++entry)
+        target.draw(m_rows[entry % m_rows.size()].text, rowStates);
+
+    target.setView(previous);
+}
+
+void FavoritesView::layoutVisibleRows() {
+    std::size_t end = getVisibleEnd();
+    for (std::size_t entry = getFirstVisible(); entry < end; ++entry) {
+        Row& row = m_rows[entry % m_rows.size()];
+        if (row.entry == entry)
+            continue;
+
+        // Строка впервые стала видимой: размечаем имя файла один раз.
+        row.entry = entry;
+        row.text.setString(sf::String(std::filesystem::path(m_entries[entry]).filename().wstring()));
+        row.text.setPosition(Margin, m_listArea.top + entry * m_rowHeight);
+    }
+}
+
+std::size_t FavoritesView::getFirstVisible() const {
+    return std::min(m_entries.size(), static_cast<std::size_t>(m_scroll / m_rowHeight));
+}
+
+std::size_t FavoritesView::getVisibleEnd() const {
+    std::size_t end = static_cast<std::size_t>(std::ceil((m_scroll + m_listArea.height) / m_rowHeight));
+    return std::min(m_entries.size(), std::min(end, getFirstVisible() + m_rows.size()));
+}
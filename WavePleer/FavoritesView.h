@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "Library.h"
+#include "TrackBitmap.h"
+
+// Экран коллекции: прокручиваемый список треков внутри главного окна.
+// Список виртуальный: размечаются только видимые строки, а готовый sf::Text строки живет,
+// пока строка видна. Слот строки выбирается по ее номеру (entry % число слотов), поэтому при
+// прокрутке на одну строку заново размечается одна строка, а не весь экран.
+// Экран не блокирует главный цикл: события передаются в handleEvent, отрисовка — через draw.
+class FavoritesView : public sf::Drawable {
+public:
+    FavoritesView(const sf::Font& font, sf::Vector2f size);
+
+    // Открывает экран со снимком треков медиатеки (например, коллекции или выборки из нескольких),
+    // упорядоченным по путям.
+    void open(const sf::String& title, const TrackBitmap& tracks, const Library& library);
+    void close();
+    bool isOpen() const;
+
+    // Обрабатывает событие открытого экрана: прокрутка колесом и клавишами, Esc закрывает экран.
+    // Возвращает true, если изображение изменилось.
+    bool handleEvent(const sf::Event& event);
+
+    // Прокручивает список на delta пикселей (положительное — вниз). Возвращает true, если список сдвинулся.
+    bool scroll(float delta);
+
+protected:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+
+private:
+    struct Row {
+        std::size_t entry;   // номер строки списка, размеченной в text
+        sf::Text    text;
+    };
+
+    // Размечает строки, которые стали видимыми.
+    void layoutVisibleRows();
+
+    std::size_t getFirstVisible() const;
+    std::size_t getVisibleEnd() const;
+
+    const sf::Font&          m_font;
+    sf::Vector2f             m_size;
+    sf::Text                 m_header;
+    sf::FloatRect            m_listArea;
+    float                    m_rowHeight;
+    float                    m_scroll;     // сдвиг списка в пикселях
+    bool                     m_isOpen;
+    std::vector<std::string> m_entries;
+    std::vector<Row>         m_rows;       // слоты видимых строк
+};
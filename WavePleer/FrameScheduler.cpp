@@ -0,0 +1,123 @@
+﻿#include "FrameScheduler.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <X11/Xlib.h>
+#endif
+
+namespace {
+    // Наименьший промежуток между кадрами. При работающей вертикальной синхронизации
+    // display() сам ждет экран, а без нее ограничение не дает циклу крутиться вхолостую.
+    const sf::Time MinFrameInterval = sf::milliseconds(4);
+
+#ifndef _WIN32
+    // Без ожидания с ограничением по времени события окна проверяются с этим периодом.
+    const sf::Time InputPollInterval = sf::milliseconds(10);
+#endif
+
+#ifdef __linux__
+    // События окна, которые приходят и на второе соединение с X-сервером. Нажатие кнопки мыши
+    // может выбрать только один клиент (SFML), а просьба закрыть окно приходит только ему.
+    const long WakeUpEventMask = KeyPressMask | KeyReleaseMask | ButtonReleaseMask | PointerMotionMask | EnterWindowMask |
+                                 LeaveWindowMask | FocusChangeMask | ExposureMask | StructureNotifyMask;
+
+    // Поэтому ожидание без срока все же прерывается с этим периодом: щелчок без движения мыши
+    // и закрытие окна обрабатываются с задержкой не больше него.
+    const sf::Time MaxIdleWait = sf::milliseconds(250);
+#endif
+}
+
+FrameScheduler::FrameScheduler(sf::RenderWindow& window)
+    : m_hasDeadline(false), m_isDirty(true) {
+    window.setVerticalSyncEnabled(true);
+
+#ifdef __linux__
+    m_display = XOpenDisplay(nullptr);
+    if (m_display) {
+        XSelectInput(m_display, window.getSystemHandle(), WakeUpEventMask);
+        XFlush(m_display);
+    }
+#endif
+}
+
+FrameScheduler::~FrameScheduler() {
+#ifdef __linux__
+    if (m_display)
+        XCloseDisplay(m_display);
+#endif
+}
+
+void FrameScheduler::invalidate() {
+    m_isDirty = true;
+}
+
+void FrameScheduler::wakeUpIn(sf::Time delay) {
+    sf::Time deadline = m_clock.getElapsedTime() + delay;
+    if (!m_hasDeadline || deadline < m_deadline)
+        m_deadline = deadline;
+    m_hasDeadline = true;
+}
+
+void FrameScheduler::wait() {
+    sf::Time now = m_clock.getElapsedTime();
+    bool isInfinite = false;
+    sf::Time timeout = sf::Time::Zero;
+    if (m_isDirty)
+        timeout = m_lastFrame + MinFrameInterval - now;
+    else if (m_hasDeadline)
+        timeout = m_deadline - now;
+    else
+        isInfinite = true;
+
+    // Сроки цикл заявляет заново на каждой итерации.
+    m_hasDeadline = false;
+
+    if (!isInfinite && timeout <= sf::Time::Zero)
+        return;
+
+#ifdef _WIN32
+    // Ждем сообщения в очереди потока: окно SFML заберет его в pollEvent.
+    DWORD milliseconds = isInfinite ? INFINITE : static_cast<DWORD>((timeout.asMicroseconds() + 999) / 1000);
+    MsgWaitForMultipleObjectsEx(0, nullptr, milliseconds, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+#else
+#ifdef __linux__
+    // Пока кнопка мыши нажата, события указателя получает только SFML (неявный захват указателя),
+    // поэтому во время перетаскивания проверяем события короткими отрезками, как без соединения.
+    if (m_display && !sf::Mouse::isButtonPressed(sf::Mouse::Left)) {
+        // Копии событий здесь не нужны: их разбирает SFML. Очищаем очередь, чтобы poll ждал новых.
+        while (XPending(m_display) > 0) {
+            XEvent event;
+            XNextEvent(m_display, &event);
+        }
+
+        sf::Time wait = isInfinite ? MaxIdleWait : std::min(timeout, MaxIdleWait);
+        pollfd descriptor = { ConnectionNumber(m_display), POLLIN, 0 };
+        poll(&descriptor, 1, static_cast<int>((wait.asMicroseconds() + 999) / 1000));
+        return;
+    }
+#endif
+    // SFML 2 не умеет ждать событие ограниченное время, поэтому спим короткими отрезками.
+    sf::sleep(isInfinite ? InputPollInterval : std::min(timeout, InputPollInterval));
+#endif
+}
+
+bool FrameScheduler::beginFrame() {
+    if (!m_isDirty)
+        return false;
+
+    m_isDirty = false;
+    m_lastFrame = m_clock.getElapsedTime();
+    return true;
+}
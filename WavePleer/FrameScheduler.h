@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#ifdef __linux__
+struct _XDisplay;
+#endif
+
+// Планировщик перерисовки главного окна.
+// Кадр рисуется, только когда изображение могло измениться: пришло событие, изменились данные
+// или анимация сделала шаг. В остальное время главный цикл спит в wait до события окна или до ближайшего
+// срока, к которому нужно забрать результаты фоновых задач, и почти не занимает процессор.
+// Кадры выводятся с вертикальной синхронизацией, то есть не чаще частоты обновления экрана.
+//
+// Итерация главного цикла: wait, обработка событий и фоновых задач с вызовами invalidate
+// и wakeUpIn, затем отрисовка, если beginFrame вернул true.
+class FrameScheduler {
+public:
+    explicit FrameScheduler(sf::RenderWindow& window);
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    // Изображение изменилось: нужно нарисовать один кадр.
+    void invalidate();
+
+    // Цикл должен проснуться не позже чем через delay, даже если событий не будет.
+    void wakeUpIn(sf::Time delay);
+
+    // Ждет события окна или ближайшего срока. Событие остается в очереди окна для pollEvent.
+    void wait();
+
+    // Нужно ли рисовать кадр в этой итерации.
+    bool beginFrame();
+
+private:
+    sf::Clock m_clock;
+    sf::Time  m_lastFrame;    // начало последнего кадра
+    sf::Time  m_deadline;     // когда проснуться, если событий не будет
+    bool      m_hasDeadline;
+    bool      m_isDirty;
+#ifdef __linux__
+    _XDisplay* m_display;     // свое соединение с X-сервером, чтобы ждать события окна с ограничением по времени
+#endif
+};
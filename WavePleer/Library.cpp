@@ -0,0 +1,123 @@
+﻿#include "Library.h"
+
+#include <filesystem>
+
+Library::Library() {
+}
+
+int Library::add(const std::string& path, const TrackInfo& info) {
+    auto found = m_indices.find(path);
+    if (found != m_indices.end()) {
+        unlinkId(found->second);
+        m_infos[found->second] = info;
+        linkId(found->second);
+        return found->second;
+    }
+
+    int index = static_cast<int>(m_paths.size());
+    m_paths.push_back(path);
+    m_infos.push_back(info);
+    m_indices.emplace(path, index);
+    linkId(index);
+    return index;
+}
+
+bool Library::remove(const std::string& path) {
+    auto found = m_indices.find(path);
+    if (found == m_indices.end())
+        return false;
+
+    // Запись остается на месте, чтобы не сдвигать индексы остальных треков.
+    unlinkId(found->second);
+    m_paths[found->second].clear();
+    m_infos[found->second] = TrackInfo();
+    m_indices.erase(found);
+    return true;
+}
+
+std::size_t Library::removeDirectory(const std::string& directory) {
+    // Пути внутри каталога идут в упорядоченной таблице подряд, начиная с "каталог/".
+    std::string prefix = directory;
+    if (!prefix.empty() && prefix.back() != static_cast<char>(std::filesystem::path::preferred_separator))
+        prefix += static_cast<char>(std::filesystem::path::preferred_separator);
+
+    std::size_t removed = 0;
+    auto it = m_indices.lower_bound(prefix);
+    while (it != m_indices.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+        unlinkId(it->second);
+        m_paths[it->second].clear();
+        m_infos[it->second] = TrackInfo();
+        it = m_indices.erase(it);
+        ++removed;
+    }
+    return removed;
+}
+
+int Library::find(const std::string& path) const {
+    auto found = m_indices.find(path);
+    return found != m_indices.end() ? found->second : -1;
+}
+
+int Library::findById(std::uint64_t id) const {
+    auto found = m_ids.find(id);
+    return found != m_ids.end() ? found->second : -1;
+}
+
+const std::string& Library::getPath(int index) const {
+    static const std::string empty;
+    if (index < 0 || index >= static_cast<int>(m_paths.size()))
+        return empty;
+    return m_paths[index];
+}
+
+const TrackInfo& Library::getInfo(int index) const {
+    static const TrackInfo empty;
+    if (index < 0 || index >= static_cast<int>(m_infos.size()))
+        return empty;
+    return m_infos[index];
+}
+
+int Library::getNext(int index) const {
+    int size = static_cast<int>(m_paths.size());
+    for (int step = 1; step <= size; ++step) {
+        int candidate = ((index + step) % size + size) % size;
+        if (!m_paths[candidate].empty())
+            return candidate;
+    }
+    return -1;
+}
+
+int Library::getPrevious(int index) const {
+    int size = static_cast<int>(m_paths.size());
+    for (int step = 1; step <= size; ++step) {
+        int candidate = ((index - step) % size + size) % size;
+        if (!m_paths[candidate].empty())
+            return candidate;
+    }
+    return -1;
+}
+
+std::size_t Library::getSize() const {
+    return m_paths.size();
+}
+
+std::size_t Library::getTrackCount() const {
+    return m_indices.size();
+}
+
+bool Library::isEmpty() const {
+    return m_indices.empty();
+}
+
+void Library::linkId(int index) {
+    // При переносе файла новый путь может прийти раньше удаления старого,
+    // поэтому идентификатор всегда переходит к последней добавленной записи.
+    if (m_infos[index].id != 0)
+        m_ids[m_infos[index].id] = index;
+}
+
+void Library::unlinkId(int index) {
+    auto found = m_ids.find(m_infos[index].id);
+    if (found != m_ids.end() && found->second == index)
+        m_ids.erase(found);
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "TagReader.h"
+
+// Список треков медиатеки.
+// Индекс трека не меняется в течение сеанса: удаленный трек оставляет пустую запись,
+// а новые треки дописываются в конец. Все методы вызываются из UI-потока.
+class Library {
+public:
+    Library();
+
+    // Добавляет трек и возвращает его индекс. Уже известный трек не дублируется, а только получает новые метаданные.
+    int add(const std::string& path, const TrackInfo& info = TrackInfo());
+
+    // Удаляет трек. Возвращает false, если такого трека нет.
+    bool remove(const std::string& path);
+
+    // Удаляет все треки внутри каталога (включая подкаталоги). Возвращает число удаленных треков.
+    std::size_t removeDirectory(const std::string& directory);
+
+    // Индекс трека или -1.
+    int find(const std::string& path) const;
+
+    // Индекс трека с данным идентификатором (TrackInfo::id) или -1.
+    // Если в медиатеке несколько копий одного трека, возвращается последняя добавленная.
+    int findById(std::uint64_t id) const;
+
+    // Путь к треку. Для удаленного трека — пустая строка.
+    const std::string& getPath(int index) const;
+
+    // Метаданные трека. Для удаленного трека — пустые.
+    const TrackInfo& getInfo(int index) const;
+
+    // Следующий и предыдущий существующие треки по кругу. -1, если треков нет.
+    int getNext(int index) const;
+    int getPrevious(int index) const;
+
+    // Число записей, включая удаленные: индексы треков меньше этого числа.
+    std::size_t getSize() const;
+
+    // Число существующих треков.
+    std::size_t getTrackCount() const;
+    bool isEmpty() const;
+
+private:
+    std::vector<std::string>             m_paths;
+    std::vector<TrackInfo>               m_infos;
+    std::map<std::string, int>           m_indices; // упорядочен, чтобы каталог удалялся за O(log N + k)
+    std::unordered_map<std::uint64_t, int> m_ids;
+
+    void linkId(int index);
+    void unlinkId(int index);
+};
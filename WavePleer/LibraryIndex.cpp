@@ -0,0 +1,254 @@
+﻿#include "LibraryIndex.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+struct LibraryIndex::Header {
+    char          magic[4];       // "WPLI"
+    std::uint32_t version;
+    std::uint32_t directoryCount;
+    std::uint32_t fileCount;
+    std::uint64_t stringsSize;
+};
+
+struct LibraryIndex::DirectoryRecord {
+    std::uint64_t pathOffset;
+    std::uint32_t pathLength;
+    std::uint32_t firstFile;
+    std::uint32_t fileCount;
+    std::uint32_t reserved;
+    std::int64_t  mtime;
+};
+
+struct LibraryIndex::FileRecord {
+    std::uint64_t nameOffset;
+    std::uint32_t nameLength;
+    std::uint32_t trackNumber;
+    std::uint64_t size;
+    std::int64_t  mtime;
+    std::uint64_t titleOffset;
+    std::uint32_t titleLength;
+    std::uint32_t duration;
+    std::uint64_t artistOffset;
+    std::uint32_t artistLength;
+    std::uint32_t albumLength;
+    std::uint64_t albumOffset;
+    std::uint64_t trackId;
+};
+
+namespace {
+    const char IndexMagic[4] = { 'W', 'P', 'L', 'I' };
+    const std::uint32_t IndexVersion = 3;
+}
+
+LibraryIndex::LibraryIndex()
+    : m_header(nullptr), m_directories(nullptr), m_files(nullptr), m_strings(nullptr) {
+}
+
+bool LibraryIndex::open(const std::string& path) {
+    close();
+    if (!m_file.open(path))
+        return false;
+
+    const unsigned char* data = m_file.getData();
+    std::size_t size = m_file.getSize();
+
+    // Проверяем заголовок и то, что все разделы помещаются в файл.
+    if (size < sizeof(Header)) {
+        close();
+        return false;
+    }
+    m_header = reinterpret_cast<const Header*>(data);
+    if (std::memcmp(m_header->magic, IndexMagic, sizeof(IndexMagic)) != 0 || m_header->version != IndexVersion) {
+        close();
+        return false;
+    }
+
+    std::uint64_t directoriesSize = static_cast<std::uint64_t>(m_header->directoryCount) * sizeof(DirectoryRecord);
+    std::uint64_t filesSize = static_cast<std::uint64_t>(m_header->fileCount) * sizeof(FileRecord);
+    if (sizeof(Header) + directoriesSize + filesSize + m_header->stringsSize != size) {
+        close();
+        return false;
+    }
+
+    m_directories = reinterpret_cast<const DirectoryRecord*>(data + sizeof(Header));
+    m_files = reinterpret_cast<const FileRecord*>(data + sizeof(Header) + directoriesSize);
+    m_strings = reinterpret_cast<const char*>(data + sizeof(Header) + directoriesSize + filesSize);
+
+    for (std::size_t i = 0; i < m_header->directoryCount; ++i) {
+        const DirectoryRecord& directory = m_directories[i];
+        if (directory.pathOffset + directory.pathLength > m_header->stringsSize ||
+            static_cast<std::uint64_t>(directory.firstFile) + directory.fileCount > m_header->fileCount) {
+            close();
+            return false;
+        }
+    }
+    for (std::size_t i = 0; i < m_header->fileCount; ++i) {
+        const FileRecord& file = m_files[i];
+        if (file.nameOffset + file.nameLength > m_header->stringsSize ||
+            file.titleOffset + file.titleLength > m_header->stringsSize ||
+            file.artistOffset + file.artistLength > m_header->stringsSize ||
+            file.albumOffset + file.albumLength > m_header->stringsSize) {
+            close();
+            return false;
+        }
+    }
+
+    // Таблица поиска каталогов по пути и списки подкаталогов строятся один раз при открытии.
+    m_lookup.reserve(m_header->directoryCount);
+    for (std::size_t i = 0; i < m_header->directoryCount; ++i)
+        m_lookup.emplace(getDirectoryPath(i), static_cast<int>(i));
+
+    m_subdirectories.resize(m_header->directoryCount);
+    for (std::size_t i = 0; i < m_header->directoryCount; ++i) {
+        std::string parent = std::filesystem::path(getDirectoryPath(i)).parent_path().string();
+        auto found = m_lookup.find(parent);
+        if (found != m_lookup.end() && found->second != static_cast<int>(i))
+            m_subdirectories[found->second].push_back(static_cast<int>(i));
+    }
+
+    return true;
+}
+
+void LibraryIndex::close() {
+    m_lookup.clear();
+    m_subdirectories.clear();
+    m_header = nullptr;
+    m_directories = nullptr;
+    m_files = nullptr;
+    m_strings = nullptr;
+    m_file.close();
+}
+
+bool LibraryIndex::isOpen() const {
+    return m_header != nullptr;
+}
+
+std::size_t LibraryIndex::getDirectoryCount() const {
+    return m_header ? m_header->directoryCount : 0;
+}
+
+int LibraryIndex::findDirectory(const std::string& path) const {
+    auto found = m_lookup.find(path);
+    return found != m_lookup.end() ? found->second : -1;
+}
+
+std::string_view LibraryIndex::getDirectoryPath(std::size_t directory) const {
+    return std::string_view(m_strings + m_directories[directory].pathOffset, m_directories[directory].pathLength);
+}
+
+std::int64_t LibraryIndex::getDirectoryTime(std::size_t directory) const {
+    return m_directories[directory].mtime;
+}
+
+const std::vector<int>& LibraryIndex::getSubdirectories(std::size_t directory) const {
+    return m_subdirectories[directory];
+}
+
+std::size_t LibraryIndex::getFirstFile(std::size_t directory) const {
+    return m_directories[directory].firstFile;
+}
+
+std::size_t LibraryIndex::getFileCount(std::size_t directory) const {
+    return m_directories[directory].fileCount;
+}
+
+std::string_view LibraryIndex::getFileName(std::size_t file) const {
+    return std::string_view(m_strings + m_files[file].nameOffset, m_files[file].nameLength);
+}
+
+std::uint64_t LibraryIndex::getFileSize(std::size_t file) const {
+    return m_files[file].size;
+}
+
+std::int64_t LibraryIndex::getFileTime(std::size_t file) const {
+    return m_files[file].mtime;
+}
+
+TrackInfo LibraryIndex::getFileInfo(std::size_t file) const {
+    const FileRecord& record = m_files[file];
+    TrackInfo info;
+    info.title.assign(m_strings + record.titleOffset, record.titleLength);
+    info.artist.assign(m_strings + record.artistOffset, record.artistLength);
+    info.album.assign(m_strings + record.albumOffset, record.albumLength);
+    info.trackNumber = record.trackNumber;
+    info.duration = record.duration;
+    info.id = record.trackId;
+    return info;
+}
+
+std::string LibraryIndex::getFilePath(std::size_t directory, std::size_t file) const {
+    return (std::filesystem::path(getDirectoryPath(directory)) / getFileName(file)).string();
+}
+
+bool LibraryIndex::write(const std::string& path, const std::vector<IndexedDirectory>& directories) {
+    Header header;
+    std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    header.version = IndexVersion;
+    header.directoryCount = static_cast<std::uint32_t>(directories.size());
+    header.fileCount = 0;
+    header.stringsSize = 0;
+
+    // Раскладываем строки и записи по разделам в памяти, а затем пишем файл одним проходом.
+    std::vector<DirectoryRecord> directoryRecords;
+    std::vector<FileRecord> fileRecords;
+    std::string strings;
+    directoryRecords.reserve(directories.size());
+
+    for (const auto& directory : directories) {
+        DirectoryRecord record = {};
+        record.pathOffset = strings.size();
+        record.pathLength = static_cast<std::uint32_t>(directory.path.size());
+        record.firstFile = static_cast<std::uint32_t>(fileRecords.size());
+        record.fileCount = static_cast<std::uint32_t>(directory.files.size());
+        record.mtime = directory.mtime;
+        strings += directory.path;
+        directoryRecords.push_back(record);
+
+        for (const auto& file : directory.files) {
+            FileRecord fileRecord = {};
+            fileRecord.nameOffset = strings.size();
+            fileRecord.nameLength = static_cast<std::uint32_t>(file.name.size());
+            fileRecord.size = file.size;
+            fileRecord.mtime = file.mtime;
+            strings += file.name;
+
+            fileRecord.trackNumber = file.info.trackNumber;
+            fileRecord.duration = file.info.duration;
+            fileRecord.trackId = file.info.id;
+            fileRecord.titleOffset = strings.size();
+            fileRecord.titleLength = static_cast<std::uint32_t>(file.info.title.size());
+            strings += file.info.title;
+            fileRecord.artistOffset = strings.size();
+            fileRecord.artistLength = static_cast<std::uint32_t>(file.info.artist.size());
+            strings += file.info.artist;
+            fileRecord.albumOffset = strings.size();
+            fileRecord.albumLength = static_cast<std::uint32_t>(file.info.album.size());
+            strings += file.info.album;
+            fileRecords.push_back(fileRecord);
+        }
+    }
+    header.fileCount = static_cast<std::uint32_t>(fileRecords.size());
+    header.stringsSize = strings.size();
+
+    std::ofstream file(path + ".tmp", std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(directoryRecords.data()), directoryRecords.size() * sizeof(DirectoryRecord));
+    file.write(reinterpret_cast<const char*>(fileRecords.data()), fileRecords.size() * sizeof(FileRecord));
+    file.write(strings.data(), strings.size());
+    file.close();
+
+    return !file.fail();
+}
+
+bool LibraryIndex::commit(const std::string& path) {
+    // Переименование атомарно: при сбое останется либо старый, либо новый индекс целиком.
+    std::error_code error;
+    std::filesystem::rename(path + ".tmp", path, error);
+    return !error;
+}
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TagReader.h"
+
+// Файл в каталоге медиатеки: имя, размер, время изменения и прочитанные из него теги.
+struct IndexedFile {
+    std::string   name;
+    std::uint64_t size;
+    std::int64_t  mtime;
+    TrackInfo     info;
+};
+
+// Каталог медиатеки со списком аудиофайлов.
+struct IndexedDirectory {
+    std::string              path;
+    std::int64_t             mtime;
+    std::vector<IndexedFile> files;
+};
+
+// Двоичный индекс медиатеки, сохраненный между запусками.
+// Файл отображается в память и читается без разбора в промежуточные структуры.
+//
+// Формат (порядок байтов платформы):
+//   заголовок | записи каталогов | записи файлов | строки (пути каталогов и имена файлов)
+// Файлы одного каталога идут подряд; имена файлов хранятся без пути каталога.
+// Вместе с файлом хранятся его теги, чтобы не разбирать неизмененные файлы при каждом запуске.
+class LibraryIndex {
+public:
+    LibraryIndex();
+
+    // Открывает индекс. Возвращает false, если файла нет или он поврежден.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    std::size_t getDirectoryCount() const;
+
+    // Номер каталога по полному пути или -1.
+    int findDirectory(const std::string& path) const;
+
+    std::string_view getDirectoryPath(std::size_t directory) const;
+    std::int64_t getDirectoryTime(std::size_t directory) const;
+
+    // Подкаталоги, которые тоже есть в индексе.
+    const std::vector<int>& getSubdirectories(std::size_t directory) const;
+
+    // Файлы каталога: номера от getFirstFile() до getFirstFile() + getFileCount().
+    std::size_t getFirstFile(std::size_t directory) const;
+    std::size_t getFileCount(std::size_t directory) const;
+
+    std::string_view getFileName(std::size_t file) const;
+    std::uint64_t getFileSize(std::size_t file) const;
+    std::int64_t getFileTime(std::size_t file) const;
+    TrackInfo getFileInfo(std::size_t file) const;
+
+    // Полный путь к файлу.
+    std::string getFilePath(std::size_t directory, std::size_t file) const;
+
+    // Записывает индекс во временный файл path.tmp. Открытый индекс при этом не трогается.
+    static bool write(const std::string& path, const std::vector<IndexedDirectory>& directories);
+
+    // Заменяет индекс path записанным ранее path.tmp. Индекс path должен быть закрыт.
+    static bool commit(const std::string& path);
+
+private:
+    struct Header;
+    struct DirectoryRecord;
+    struct FileRecord;
+
+    MappedFile                                m_file;
+    const Header*                             m_header;
+    const DirectoryRecord*                    m_directories;
+    const FileRecord*                         m_files;
+    const char*                               m_strings;
+    std::unordered_map<std::string_view, int> m_lookup;
+    std::vector<std::vector<int>>             m_subdirectories;
+};
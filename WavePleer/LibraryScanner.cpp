@@ -0,0 +1,237 @@
+﻿#include "LibraryScanner.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "TagReader.h"
+#include "TrackId.h"
+
+LibraryScanner::LibraryScanner(const std::vector<std::string>& roots, const LibraryIndex& previousIndex, const std::string& indexPath, unsigned int workerCount)
+    : m_previous(previousIndex), m_indexPath(indexPath), m_activeWorkers(0), m_stopping(false), m_finishing(false), m_finished(false),
+      m_visited(previousIndex.getDirectoryCount(), 0) {
+    for (const auto& root : roots)
+        m_directories.emplace_back(root);
+
+    // Обходить нечего.
+    if (m_directories.empty())
+        m_finished = true;
+
+    // Обход упирается в задержки диска, а не в процессор, поэтому потоков не меньше четырех.
+    if (workerCount == 0)
+        workerCount = std::max(4u, std::thread::hardware_concurrency());
+
+    for (unsigned int i = 0; i < workerCount; ++i)
+        m_workers.emplace_back(&LibraryScanner::run, this);
+}
+
+LibraryScanner::~LibraryScanner() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+bool LibraryScanner::takeResults(Library& library, std::vector<int>& added) {
+    std::vector<FoundTrack> found;
+    std::vector<std::string> removed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        found.swap(m_added);
+        removed.swap(m_removed);
+    }
+
+    for (const auto& path : removed)
+        library.remove(path);
+    for (const auto& track : found)
+        added.push_back(library.add(track.path, track.info));
+
+    return !found.empty() || !removed.empty();
+}
+
+bool LibraryScanner::isFinished() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_finished && m_added.empty() && m_removed.empty();
+}
+
+bool LibraryScanner::isSupportedAudioFile(const std::filesystem::path& path) {
+    // Форматы, которые читает sf::SoundFileFactory: WAV, Ogg Vorbis, FLAC и MP3.
+    static const char* const extensions[] = { ".wav", ".ogg", ".oga", ".flac", ".mp3" };
+
+    std::string extension = path.extension().string();
+    for (auto& c : extension)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+    for (const char* supported : extensions) {
+        if (extension == supported)
+            return true;
+    }
+    return false;
+}
+
+void LibraryScanner::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        // Ждем каталог для обхода. Если очередь пуста и никто не работает, новых каталогов уже не будет.
+        m_condition.wait(lock, [this] { return m_stopping || !m_directories.empty() || m_activeWorkers == 0; });
+        if (m_stopping || m_directories.empty())
+            break;
+
+        std::filesystem::path directory = std::move(m_directories.back());
+        m_directories.pop_back();
+        ++m_activeWorkers;
+        lock.unlock();
+
+        std::vector<std::filesystem::path> subdirectories;
+        visitDirectory(directory, subdirectories);
+
+        lock.lock();
+        --m_activeWorkers;
+        m_directories.insert(m_directories.end(), std::make_move_iterator(subdirectories.begin()), std::make_move_iterator(subdirectories.end()));
+
+        bool done = m_directories.empty() && m_activeWorkers == 0;
+        if (!subdirectories.empty() || done)
+            m_condition.notify_all();
+
+        // Последний поток подводит итоги обхода.
+        if (done && !m_finishing) {
+            m_finishing = true;
+            lock.unlock();
+            finish();
+            lock.lock();
+            m_finished = true;
+        }
+    }
+}
+
+void LibraryScanner::visitDirectory(const std::filesystem::path& directory, std::vector<std::filesystem::path>& subdirectories) {
+    // Недоступный каталог пропускаем: если он был в индексе, его файлы считаются удаленными.
+    std::error_code error;
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(directory, error);
+    if (error)
+        return;
+
+    IndexedDirectory scanned;
+    scanned.path = directory.string();
+    scanned.mtime = static_cast<std::int64_t>(time.time_since_epoch().count());
+
+    std::vector<FoundTrack> added;
+    std::vector<std::string> removed;
+    int previous = m_previous.findDirectory(scanned.path);
+
+    if (previous >= 0 && m_previous.getDirectoryTime(previous) == scanned.mtime) {
+        // Каталог не менялся: его содержимое берем из индекса, не читая каталог.
+        std::size_t first = m_previous.getFirstFile(previous);
+        std::size_t last = first + m_previous.getFileCount(previous);
+        for (std::size_t file = first; file < last; ++file)
+            scanned.files.push_back({ std::string(m_previous.getFileName(file)), m_previous.getFileSize(file), m_previous.getFileTime(file), m_previous.getFileInfo(file) });
+
+        for (int subdirectory : m_previous.getSubdirectories(previous))
+            subdirectories.emplace_back(m_previous.getDirectoryPath(subdirectory));
+    }
+    else {
+        readDirectory(directory, scanned, subdirectories);
+
+        // Сверяем содержимое с индексом: передаем только появившиеся, измененные и исчезнувшие файлы.
+        std::unordered_map<std::string_view, std::size_t> previousFiles;
+        if (previous >= 0) {
+            std::size_t first = m_previous.getFirstFile(previous);
+            std::size_t last = first + m_previous.getFileCount(previous);
+            for (std::size_t file = first; file < last; ++file)
+                previousFiles.emplace(m_previous.getFileName(file), file);
+        }
+
+        std::unordered_set<std::string_view> currentNames;
+        for (auto& file : scanned.files) {
+            currentNames.insert(file.name);
+
+            // Теги читаются заново, только если файл новый или изменился.
+            auto found = previousFiles.find(file.name);
+            if (found != previousFiles.end() && m_previous.getFileSize(found->second) == file.size && m_previous.getFileTime(found->second) == file.mtime) {
+                file.info = m_previous.getFileInfo(found->second);
+                continue;
+            }
+
+            std::string path = (directory / file.name).string();
+            TagReader::read(path, file.info);
+            file.info.id = TrackId::compute(path);
+            added.push_back({ std::move(path), file.info });
+        }
+        for (const auto& entry : previousFiles) {
+            if (currentNames.find(entry.first) == currentNames.end())
+                removed.push_back((directory / entry.first).string());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (previous >= 0)
+        m_visited[previous] = 1;
+    m_added.insert(m_added.end(), std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+    m_removed.insert(m_removed.end(), std::make_move_iterator(removed.begin()), std::make_move_iterator(removed.end()));
+    m_scanned.push_back(std::move(scanned));
+}
+
+void LibraryScanner::readDirectory(const std::filesystem::path& directory, IndexedDirectory& scanned, std::vector<std::filesystem::path>& subdirectories) {
+    // Ошибки доступа не прерывают обход: недоступный каталог просто пропускается.
+    std::error_code error;
+    std::filesystem::directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, error);
+    std::filesystem::directory_iterator end;
+
+    for (; !error && it != end; it.increment(error)) {
+        // По символическим ссылкам на каталоги не переходим, чтобы не зациклиться.
+        std::filesystem::file_status status = it->symlink_status(error);
+        if (error) {
+            error.clear();
+            continue;
+        }
+
+        if (std::filesystem::is_directory(status)) {
+            subdirectories.push_back(it->path());
+        }
+        else if (isSupportedAudioFile(it->path())) {
+            IndexedFile file;
+            file.name = it->path().filename().string();
+            file.size = it->file_size(error);
+            file.mtime = static_cast<std::int64_t>(it->last_write_time(error).time_since_epoch().count());
+            error.clear();
+            scanned.files.push_back(std::move(file));
+        }
+    }
+
+    // Треки альбома идут подряд и по порядку имен файлов.
+    std::sort(scanned.files.begin(), scanned.files.end(), [](const IndexedFile& left, const IndexedFile& right) {
+        return left.name < right.name;
+    });
+}
+
+void LibraryScanner::finish() {
+    std::vector<std::string> removed;
+
+    // Каталоги из индекса, до которых обход не дошел, больше не существуют.
+    for (std::size_t directory = 0; directory < m_visited.size(); ++directory) {
+        if (m_visited[directory])
+            continue;
+
+        std::size_t first = m_previous.getFirstFile(directory);
+        std::size_t last = first + m_previous.getFileCount(directory);
+        for (std::size_t file = first; file < last; ++file)
+            removed.push_back(m_previous.getFilePath(directory, file));
+    }
+
+    std::sort(m_scanned.begin(), m_scanned.end(), [](const IndexedDirectory& left, const IndexedDirectory& right) {
+        return left.path < right.path;
+    });
+    if (!LibraryIndex::write(m_indexPath, m_scanned))
+        std::cerr << "Failed to write library index: " << m_indexPath << std::endl;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_removed.insert(m_removed.end(), std::make_move_iterator(removed.begin()), std::make_move_iterator(removed.end()));
+}
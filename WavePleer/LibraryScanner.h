@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Library.h"
+#include "LibraryIndex.h"
+
+// Параллельный рекурсивный обход медиатеки.
+// Несколько рабочих потоков обходят каталоги из общей очереди, а найденные изменения
+// передаются UI-потоку порциями, поэтому окно открывается сразу, не дожидаясь конца обхода.
+//
+// Если есть индекс прошлого запуска, каталоги с неизменным временем изменения не читаются:
+// их файлы и подкаталоги берутся из индекса. UI-потоку передаются только отличия от индекса.
+// Теги новых и измененных файлов читаются здесь же, в рабочих потоках (см. TagReader),
+// а для остальных берутся из индекса.
+// По окончании обхода новый индекс записывается во временный файл (см. LibraryIndex::commit).
+class LibraryScanner {
+public:
+    // previousIndex должен оставаться открытым до окончания обхода.
+    // workerCount = 0 — по числу ядер процессора.
+    LibraryScanner(const std::vector<std::string>& roots, const LibraryIndex& previousIndex, const std::string& indexPath, unsigned int workerCount = 0);
+    ~LibraryScanner();
+
+    LibraryScanner(const LibraryScanner&) = delete;
+    LibraryScanner& operator=(const LibraryScanner&) = delete;
+
+    // Применяет к медиатеке изменения, найденные с прошлого вызова. Возвращает false, если их нет.
+    // Файлы одного каталога добавляются подряд и отсортированы по имени.
+    // Индексы добавленных и измененных треков дописываются в added.
+    bool takeResults(Library& library, std::vector<int>& added);
+
+    // Обход завершен, индекс записан и все изменения переданы.
+    bool isFinished() const;
+
+    // Может ли SFML прочитать файл с таким расширением (без учета регистра).
+    static bool isSupportedAudioFile(const std::filesystem::path& path);
+
+private:
+    // Найденный трек вместе с тегами.
+    struct FoundTrack {
+        std::string path;
+        TrackInfo   info;
+    };
+
+    void run();
+
+    // Обходит один каталог: подкаталоги возвращаются для постановки в очередь.
+    void visitDirectory(const std::filesystem::path& directory, std::vector<std::filesystem::path>& subdirectories);
+
+    // Читает каталог с диска.
+    static void readDirectory(const std::filesystem::path& directory, IndexedDirectory& scanned, std::vector<std::filesystem::path>& subdirectories);
+
+    // Собирает удаленные каталоги и записывает новый индекс (последний рабочий поток).
+    void finish();
+
+    const LibraryIndex&                m_previous;
+    std::string                        m_indexPath;
+
+    mutable std::mutex                 m_mutex;
+    std::condition_variable            m_condition;
+    std::vector<std::filesystem::path> m_directories;   // каталоги, ожидающие обхода
+    std::size_t                        m_activeWorkers; // потоки, которые сейчас читают каталог
+    bool                               m_stopping;
+    bool                               m_finishing;
+    bool                               m_finished;
+
+    std::vector<IndexedDirectory>      m_scanned;       // содержимое нового индекса
+    std::vector<char>                  m_visited;       // какие каталоги старого индекса еще существуют
+    std::vector<FoundTrack>            m_added;         // найденные или измененные, но еще не переданные файлы
+    std::vector<std::string>           m_removed;       // исчезнувшие, но еще не переданные файлы
+    std::vector<std::thread>           m_workers;
+};
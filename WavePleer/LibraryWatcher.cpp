@@ -0,0 +1,265 @@
+﻿#include "LibraryWatcher.h"
+
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#include "LibraryScanner.h"
+#include "TagReader.h"
+#include "TrackId.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+    // События, которые меняют состав медиатеки. Файл считается добавленным, когда запись в него закончена.
+    const std::uint32_t WatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+    // Пакет отправляется после паузы в событиях, но не реже раза в секунду.
+    const std::chrono::milliseconds BatchQuietTime(250);
+    const std::chrono::milliseconds BatchMaxTime(1000);
+}
+#endif
+
+LibraryWatcher::LibraryWatcher(const std::vector<std::string>& roots) {
+#ifdef __linux__
+    m_roots = roots;
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_inotify < 0 || m_wakeup < 0) {
+        std::cerr << "Failed to start library watcher" << std::endl;
+        return;
+    }
+
+    m_thread = std::thread(&LibraryWatcher::run, this);
+#else
+    (void)roots;
+#endif
+}
+
+LibraryWatcher::~LibraryWatcher() {
+#ifdef __linux__
+    if (m_thread.joinable()) {
+        std::uint64_t value = 1;
+        if (write(m_wakeup, &value, sizeof(value)) < 0)
+            std::cerr << "Failed to stop library watcher" << std::endl;
+        m_thread.join();
+    }
+    if (m_inotify >= 0)
+        close(m_inotify);
+    if (m_wakeup >= 0)
+        close(m_wakeup);
+#endif
+}
+
+bool LibraryWatcher::takeChanges(Library& library, std::vector<int>& added) {
+    std::vector<Change> changes;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        changes.swap(m_ready);
+    }
+
+    for (const auto& change : changes) {
+        switch (change.type) {
+        case Change::AddFile:
+            added.push_back(library.add(change.path, change.info));
+            break;
+        case Change::RemoveFile:
+            library.remove(change.path);
+            break;
+        case Change::RemoveDirectory:
+            library.removeDirectory(change.path);
+            break;
+        }
+    }
+
+    return !changes.empty();
+}
+
+bool LibraryWatcher::isSupported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef __linux__
+void LibraryWatcher::run() {
+    // Наблюдение за уже существующими каталогами ставим в этом потоке, чтобы не задерживать запуск.
+    for (const auto& root : m_roots)
+        watchTree(root, false);
+
+    pollfd descriptors[2] = { { m_inotify, POLLIN, 0 }, { m_wakeup, POLLIN, 0 } };
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    while (true) {
+        // Без накопленных событий спим до следующего события, иначе — до отправки пакета.
+        int timeout = -1;
+        if (!m_batch.empty()) {
+            auto deadline = std::min(m_lastEvent + BatchQuietTime, m_batchStart + BatchMaxTime);
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            timeout = static_cast<int>(std::max<std::chrono::milliseconds::rep>(0, remaining.count()));
+        }
+
+        int ready = poll(descriptors, 2, timeout);
+        if (ready < 0 && errno != EINTR)
+            break;
+        if (descriptors[1].revents & POLLIN)
+            break;
+
+        if (ready > 0 && (descriptors[0].revents & POLLIN)) {
+            ssize_t length;
+            while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0) {
+                for (char* position = buffer; position < buffer + length;) {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(position);
+                    handleEvent(event->wd, event->mask, event->len ? event->name : "");
+                    position += sizeof(inotify_event) + event->len;
+                }
+            }
+            m_lastEvent = std::chrono::steady_clock::now();
+        }
+
+        if (!m_batch.empty()) {
+            auto now = std::chrono::steady_clock::now();
+            if (now - m_lastEvent >= BatchQuietTime || now - m_batchStart >= BatchMaxTime)
+                publishBatch();
+        }
+    }
+}
+
+void LibraryWatcher::watchTree(const std::string& directory, bool reportFiles) {
+    std::vector<std::string> pending(1, directory);
+    while (!pending.empty()) {
+        std::string current = std::move(pending.back());
+        pending.pop_back();
+
+        int watch = inotify_add_watch(m_inotify, current.c_str(), WatchMask);
+        if (watch < 0) {
+            if (errno == ENOSPC)
+                std::cerr << "Library watcher limit reached (fs.inotify.max_user_watches): " << current << std::endl;
+            continue;
+        }
+
+        // Перемещенный каталог сохраняет свой дескриптор: забываем его старый путь.
+        auto previous = m_watches.find(watch);
+        if (previous != m_watches.end() && previous->second != current)
+            m_directories.erase(previous->second);
+        m_watches[watch] = current;
+        m_directories[current] = watch;
+
+        std::error_code error;
+        std::filesystem::directory_iterator it(current, std::filesystem::directory_options::skip_permission_denied, error);
+        std::filesystem::directory_iterator end;
+        for (; !error && it != end; it.increment(error)) {
+            std::filesystem::file_status status = it->symlink_status(error);
+            if (error) {
+                error.clear();
+                continue;
+            }
+
+            if (std::filesystem::is_directory(status))
+                pending.push_back(it->path().string());
+            else if (reportFiles && LibraryScanner::isSupportedAudioFile(it->path()))
+                addChange(Change::AddFile, it->path().string());
+        }
+    }
+}
+
+void LibraryWatcher::unwatchTree(const std::string& directory) {
+    std::string prefix = directory + '/';
+    auto it = m_directories.lower_bound(directory);
+    while (it != m_directories.end() && (it->first == directory || it->first.compare(0, prefix.size(), prefix) == 0)) {
+        // Для удаленного каталога ядро уже сняло наблюдение, ошибку игнорируем.
+        inotify_rm_watch(m_inotify, it->second);
+        m_watches.erase(it->second);
+        it = m_directories.erase(it);
+    }
+}
+
+void LibraryWatcher::handleEvent(int watch, std::uint32_t mask, const char* name) {
+    if (mask & IN_Q_OVERFLOW) {
+        std::cerr << "Library watcher queue overflow: some changes were missed until the next launch" << std::endl;
+        return;
+    }
+
+    auto found = m_watches.find(watch);
+    if (found == m_watches.end())
+        return;
+
+    // Наблюдение снято ядром (каталог удален).
+    if (mask & IN_IGNORED) {
+        auto directory = m_directories.find(found->second);
+        if (directory != m_directories.end() && directory->second == watch)
+            m_directories.erase(directory);
+        m_watches.erase(found);
+        return;
+    }
+
+    std::string path = (std::filesystem::path(found->second) / name).string();
+
+    if (mask & IN_ISDIR) {
+        // Новый или перемещенный сюда каталог: его файлы добавляются, за ним тоже нужно следить.
+        if (mask & (IN_CREATE | IN_MOVED_TO)) {
+            watchTree(path, true);
+        }
+        else if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+            unwatchTree(path);
+            addChange(Change::RemoveDirectory, path);
+        }
+        return;
+    }
+
+    if (!LibraryScanner::isSupportedAudioFile(path))
+        return;
+
+    // Переименование приходит парой MOVED_FROM/MOVED_TO и сводится к удалению и добавлению.
+    if (mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+        addChange(Change::AddFile, path);
+    else if (mask & (IN_DELETE | IN_MOVED_FROM))
+        addChange(Change::RemoveFile, path);
+}
+
+void LibraryWatcher::addChange(Change::Type type, const std::string& path) {
+    if (m_batch.empty())
+        m_batchStart = std::chrono::steady_clock::now();
+
+    if (type == Change::RemoveDirectory) {
+        // Последующие изменения файлов должны идти после удаления каталога, поэтому не объединяем их с прежними.
+        m_batchFiles.clear();
+        m_batch.push_back({ type, path, TrackInfo() });
+        return;
+    }
+
+    // Несколько событий одного файла в пакете сводятся к последнему.
+    auto found = m_batchFiles.find(path);
+    if (found != m_batchFiles.end()) {
+        m_batch[found->second].type = type;
+        return;
+    }
+
+    m_batchFiles.emplace(path, m_batch.size());
+    m_batch.push_back({ type, path, TrackInfo() });
+}
+
+void LibraryWatcher::publishBatch() {
+    // Файл мог измениться несколько раз за пакет, поэтому теги читаются только сейчас.
+    for (auto& change : m_batch) {
+        if (change.type == Change::AddFile) {
+            TagReader::read(change.path, change.info);
+            change.info.id = TrackId::compute(change.path);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_ready.insert(m_ready.end(), std::make_move_iterator(m_batch.begin()), std::make_move_iterator(m_batch.end()));
+    }
+    m_batch.clear();
+    m_batchFiles.clear();
+}
+#endif
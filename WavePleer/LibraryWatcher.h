@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Library.h"
+
+// Слежение за каталогами медиатеки во время работы плеера (Linux, inotify).
+// Добавление, удаление, переименование и перемещение файлов и каталогов переводятся
+// в изменения медиатеки. Всплески событий (например, копирование целого альбома)
+// собираются в пакеты, и UI-поток получает не больше одного пакета за паузу в событиях.
+//
+// Индекс на диске отдельно не переписывается: время изменения затронутых каталогов меняется,
+// и при следующем запуске LibraryScanner перечитает только их.
+// На других платформах слежение не поддерживается, и takeChanges всегда возвращает false.
+class LibraryWatcher {
+public:
+    explicit LibraryWatcher(const std::vector<std::string>& roots);
+    ~LibraryWatcher();
+
+    LibraryWatcher(const LibraryWatcher&) = delete;
+    LibraryWatcher& operator=(const LibraryWatcher&) = delete;
+
+    // Применяет к медиатеке накопленные пакеты изменений. Возвращает false, если их нет.
+    // Индексы добавленных и измененных треков дописываются в added.
+    bool takeChanges(Library& library, std::vector<int>& added);
+
+    // Доступно ли слежение на этой платформе.
+    static bool isSupported();
+
+private:
+    struct Change {
+        enum Type {
+            AddFile,
+            RemoveFile,
+            RemoveDirectory
+        };
+
+        Type        type;
+        std::string path;
+        TrackInfo   info;   // теги добавленного файла
+    };
+
+#ifdef __linux__
+    void run();
+
+    // Ставит наблюдение на каталог и все его подкаталоги. При reportFiles найденные файлы считаются добавленными.
+    void watchTree(const std::string& directory, bool reportFiles);
+
+    // Снимает наблюдение с каталога и всех его подкаталогов.
+    void unwatchTree(const std::string& directory);
+
+    void handleEvent(int watch, std::uint32_t mask, const char* name);
+    void addChange(Change::Type type, const std::string& path);
+
+    // Читает теги добавленных файлов и передает накопленный пакет UI-потоку.
+    void publishBatch();
+
+    int                                  m_inotify;
+    int                                  m_wakeup;      // eventfd для остановки потока
+    std::vector<std::string>             m_roots;
+    std::unordered_map<int, std::string> m_watches;     // дескриптор наблюдения -> каталог
+    std::map<std::string, int>           m_directories; // каталог -> дескриптор (упорядочен для поддеревьев)
+
+    // Пакет, который собирается в потоке наблюдения.
+    std::vector<Change>                          m_batch;
+    std::unordered_map<std::string, std::size_t> m_batchFiles; // файл -> позиция в пакете
+    std::chrono::steady_clock::time_point        m_batchStart;
+    std::chrono::steady_clock::time_point        m_lastEvent;
+#endif
+
+    std::mutex          m_mutex;
+    std::vector<Change> m_ready;   // пакеты, готовые для UI-потока
+    std::thread         m_thread;
+};
@@ -0,0 +1,300 @@
+﻿#include "LoudnessAnalyzer.h"
+
+#include <SFML/Audio.hpp>
+#include <algorithm>
+#include <cmath>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+namespace {
+    const double Pi = 3.14159265358979323846;
+
+    // Блок измерения 400 мс со сдвигом 100 мс: громкость копится по четвертям блока.
+    const unsigned int SubBlocksPerBlock = 4;
+
+    const double AbsoluteGate = -70.0;
+    const double RelativeGate = -10.0;
+
+    // Истинный пик: передискретизация в 4 раза фильтром из 48 отсчетов (12 на фазу).
+    const int OversampleFactor = 4;
+    const int TapsPerPhase = 12;
+
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+        double z1 = 0.0, z2 = 0.0;
+
+        double process(double x) {
+            double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    // Фильтры K-взвешивания BS.1770, пересчитанные для частоты дискретизации трека.
+    void makeKWeighting(double sampleRate, Biquad& shelf, Biquad& highPass) {
+        double f0 = 1681.974450955533;
+        double gain = 3.999843853973347;
+        double q = 0.7071752369554196;
+        double k = std::tan(Pi * f0 / sampleRate);
+        double vh = std::pow(10.0, gain / 20.0);
+        double vb = std::pow(vh, 0.4996667741545416);
+        double a0 = 1.0 + k / q + k * k;
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+        f0 = 38.13547087602444;
+        q = 0.5003270373238773;
+        k = std::tan(Pi * f0 / sampleRate);
+        a0 = 1.0 + k / q + k * k;
+        highPass.b0 = 1.0;
+        highPass.b1 = -2.0;
+        highPass.b2 = 1.0;
+        highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    // Вес канала: левый, правый и центральный — 1, тыловые 5.1 — 1.41, низкочастотный — 0.
+    double getChannelWeight(unsigned int channel, unsigned int channelCount) {
+        if (channelCount == 6 && channel == 3)
+            return 0.0;
+        if (channelCount == 6 && channel >= 4)
+            return 1.41;
+        return 1.0;
+    }
+
+    // Коэффициенты интерполирующего фильтра (окно Блэкмана), по фазам.
+    struct Oversampler {
+        float coefficients[OversampleFactor][TapsPerPhase];
+
+        Oversampler() {
+            const int length = OversampleFactor * TapsPerPhase;
+            for (int i = 0; i < length; ++i) {
+                double t = (i - (length - 1) / 2.0) / OversampleFactor;
+                double sinc = t == 0.0 ? 1.0 : std::sin(Pi * t) / (Pi * t);
+                double window = 0.42 - 0.5 * std::cos(2.0 * Pi * i / (length - 1)) + 0.08 * std::cos(4.0 * Pi * i / (length - 1));
+                coefficients[i % OversampleFactor][i / OversampleFactor] = static_cast<float>(sinc * window);
+            }
+        }
+    };
+
+    const Oversampler& getOversampler() {
+        static const Oversampler oversampler;
+        return oversampler;
+    }
+
+    double toLoudness(double energy) {
+        return -0.691 + 10.0 * std::log10(energy);
+    }
+
+    void lowerThreadPriority() {
+#ifdef _WIN32
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#endif
+    }
+}
+
+LoudnessAnalyzer::LoudnessAnalyzer()
+    : m_running(true), m_inFlight(0) {
+    unsigned int workerCount = std::max(1u, std::thread::hardware_concurrency());
+    m_allowedWorkers = workerCount;
+    for (unsigned int i = 0; i < workerCount; ++i)
+        m_threads.emplace_back(&LoudnessAnalyzer::run, this, i);
+}
+
+LoudnessAnalyzer::~LoudnessAnalyzer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_condition.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void LoudnessAnalyzer::request(std::uint64_t id, const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests.push_back({ id, path });
+    }
+    m_condition.notify_one();
+}
+
+bool LoudnessAnalyzer::takeResults(std::vector<Result>& results) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_results.empty())
+        return false;
+
+    results.swap(m_results);
+    m_results.clear();
+    return true;
+}
+
+bool LoudnessAnalyzer::isBusy() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_requests.empty() || m_inFlight > 0 || !m_results.empty();
+}
+
+void LoudnessAnalyzer::setThrottled(bool isThrottled) {
+    unsigned int allowed = isThrottled ? 1u : static_cast<unsigned int>(m_threads.size());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (allowed == m_allowedWorkers)
+            return;
+        m_allowedWorkers = allowed;
+    }
+    m_condition.notify_all();
+}
+
+void LoudnessAnalyzer::run(unsigned int workerIndex) {
+    lowerThreadPriority();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_condition.wait(lock, [this, workerIndex] { return !m_running || (!m_requests.empty() && workerIndex < m_allowedWorkers); });
+        if (!m_running)
+            break;
+
+        Request request = std::move(m_requests.front());
+        m_requests.pop_front();
+        ++m_inFlight;
+        lock.unlock();
+
+        Result result;
+        result.id = request.id;
+        result.isValid = measure(request.path, result.info, workerIndex);
+
+        lock.lock();
+        --m_inFlight;
+        if (!m_running)
+            break;
+        m_results.push_back(result);
+    }
+}
+
+bool LoudnessAnalyzer::waitForTurn(unsigned int workerIndex) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this, workerIndex] { return !m_running || workerIndex < m_allowedWorkers; });
+    return m_running;
+}
+
+bool LoudnessAnalyzer::measure(const std::string& path, LoudnessInfo& info, unsigned int workerIndex) {
+    sf::InputSoundFile file;
+    if (!file.openFromFile(path))
+        return false;
+
+    unsigned int channelCount = file.getChannelCount();
+    unsigned int sampleRate = file.getSampleRate();
+    if (channelCount == 0 || sampleRate == 0)
+        return false;
+
+    std::vector<Biquad> shelves(channelCount);
+    std::vector<Biquad> highPasses(channelCount);
+    for (unsigned int channel = 0; channel < channelCount; ++channel)
+        makeKWeighting(sampleRate, shelves[channel], highPasses[channel]);
+
+    const Oversampler& oversampler = getOversampler();
+    // Последние отсчеты каждого канала, записанные дважды подряд, чтобы окно фильтра всегда было непрерывным.
+    std::vector<float> history(channelCount * TapsPerPhase * 2, 0.f);
+    float peak = 0.f;
+
+    // Энергия четвертей блока; громкость блока — среднее четырех соседних.
+    std::size_t subBlockFrames = sampleRate / 10;
+    std::vector<double> subBlocks;
+    double subBlockEnergy = 0.0;
+    std::size_t subBlockFilled = 0;
+
+    std::vector<sf::Int16> samples(static_cast<std::size_t>(sampleRate) * channelCount);
+    sf::Uint64 frameCount = 0;
+    std::size_t historyPosition = 0;
+
+    while (true) {
+        // Между кусками по секунде звука уступаем процессор, если воспроизведению он нужнее.
+        if (!waitForTurn(workerIndex))
+            return false;
+
+        std::size_t read = static_cast<std::size_t>(file.read(samples.data(), samples.size()));
+        std::size_t frames = read / channelCount;
+        if (frames == 0)
+            break;
+
+        for (std::size_t frame = 0; frame < frames; ++frame) {
+            double energy = 0.0;
+            for (unsigned int channel = 0; channel < channelCount; ++channel) {
+                float x = samples[frame * channelCount + channel] / 32768.f;
+
+                double weighted = highPasses[channel].process(shelves[channel].process(x));
+                energy += getChannelWeight(channel, channelCount) * weighted * weighted;
+
+                // Истинный пик: отсчеты между исходными восстанавливаются интерполяцией.
+                float* channelHistory = history.data() + channel * TapsPerPhase * 2;
+                channelHistory[historyPosition] = x;
+                channelHistory[historyPosition + TapsPerPhase] = x;
+                const float* newest = channelHistory + historyPosition + TapsPerPhase;
+                for (int phase = 0; phase < OversampleFactor; ++phase) {
+                    float value = 0.f;
+                    for (int tap = 0; tap < TapsPerPhase; ++tap)
+                        value += oversampler.coefficients[phase][tap] * newest[-tap];
+                    peak = std::max(peak, std::fabs(value));
+                }
+                peak = std::max(peak, std::fabs(x));
+            }
+            historyPosition = (historyPosition + 1) % TapsPerPhase;
+
+            subBlockEnergy += energy;
+            if (++subBlockFilled == subBlockFrames) {
+                subBlocks.push_back(subBlockEnergy / subBlockFrames);
+                subBlockEnergy = 0.0;
+                subBlockFilled = 0;
+            }
+        }
+        frameCount += frames;
+    }
+
+    // Блоки, прошедшие абсолютный порог.
+    std::vector<double> blocks;
+    for (std::size_t i = 0; i + SubBlocksPerBlock <= subBlocks.size(); ++i) {
+        double energy = 0.0;
+        for (unsigned int j = 0; j < SubBlocksPerBlock; ++j)
+            energy += subBlocks[i + j];
+        energy /= SubBlocksPerBlock;
+        if (energy > 0.0 && toLoudness(energy) > AbsoluteGate)
+            blocks.push_back(energy);
+    }
+
+    info.duration = static_cast<std::uint32_t>(frameCount * 1000 / sampleRate);
+    info.truePeak = peak > 0.f ? static_cast<float>(20.0 * std::log10(peak)) : -120.f;
+    if (blocks.empty()) {
+        // Тишина или трек короче блока.
+        info.integrated = static_cast<float>(AbsoluteGate);
+        return true;
+    }
+
+    // Относительный порог — на 10 LU ниже средней громкости блоков.
+    double sum = 0.0;
+    for (double energy : blocks)
+        sum += energy;
+    double threshold = toLoudness(sum / blocks.size()) + RelativeGate;
+
+    double gatedSum = 0.0;
+    std::size_t gatedCount = 0;
+    for (double energy : blocks) {
+        if (toLoudness(energy) > threshold) {
+            gatedSum += energy;
+            ++gatedCount;
+        }
+    }
+    info.integrated = static_cast<float>(gatedCount > 0 ? toLoudness(gatedSum / gatedCount) : toLoudness(sum / blocks.size()));
+    return true;
+}
@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Громкость трека по EBU R128 (ITU-R BS.1770).
+struct LoudnessInfo {
+    float         integrated = 0.f;  // интегральная громкость, LUFS
+    float         truePeak = 0.f;    // истинный пик, dBTP
+    std::uint32_t duration = 0;      // длительность в миллисекундах
+};
+
+// Фоновый анализ громкости треков.
+// Треки декодируются целиком на пуле потоков с низким приоритетом: по потоку на ядро, пока
+// компьютер простаивает, и один поток, пока идет воспроизведение или UI занят (setThrottled).
+// Результаты забирает UI-поток через takeResults.
+class LoudnessAnalyzer {
+public:
+    struct Result {
+        std::uint64_t id;
+        LoudnessInfo  info;
+        bool          isValid;   // false — файл не удалось декодировать
+    };
+
+    LoudnessAnalyzer();
+    ~LoudnessAnalyzer();
+
+    LoudnessAnalyzer(const LoudnessAnalyzer&) = delete;
+    LoudnessAnalyzer& operator=(const LoudnessAnalyzer&) = delete;
+
+    // Ставит трек в очередь анализа.
+    void request(std::uint64_t id, const std::string& path);
+
+    // Забирает готовые результаты. Возвращает false, если их нет.
+    bool takeResults(std::vector<Result>& results);
+
+    // Есть ли незавершенные запросы или незабранные результаты.
+    bool isBusy() const;
+
+    // Воспроизведению или UI нужен процессор: анализ сокращается до одного потока.
+    void setThrottled(bool isThrottled);
+
+private:
+    struct Request {
+        std::uint64_t id;
+        std::string   path;
+    };
+
+    void run(unsigned int workerIndex);
+
+    // Измеряет громкость файла (фоновый поток).
+    bool measure(const std::string& path, LoudnessInfo& info, unsigned int workerIndex);
+
+    // Ждет, пока потоку workerIndex разрешено работать. Возвращает false при завершении.
+    bool waitForTurn(unsigned int workerIndex);
+
+    mutable std::mutex       m_mutex;
+    std::condition_variable  m_condition;
+    std::vector<std::thread> m_threads;
+    bool                     m_running;
+    std::deque<Request>      m_requests;
+    std::vector<Result>      m_results;
+    unsigned int             m_inFlight;
+    unsigned int             m_allowedWorkers;
+};
@@ -0,0 +1,127 @@
+﻿#include "MappedFile.h"
+
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : m_view(nullptr), m_viewSize(0), m_delta(0), m_size(0), m_fileSize(0) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path, std::size_t offset, std::size_t length) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(std::filesystem::path(path).wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+    m_fileSize = static_cast<std::size_t>(fileSize.QuadPart);
+
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    std::size_t granularity = systemInfo.dwAllocationGranularity;
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0) {
+        ::close(file);
+        return false;
+    }
+    m_fileSize = static_cast<std::size_t>(fileStat.st_size);
+
+    std::size_t granularity = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+
+    // Пустой файл или смещение за его концом отобразить нельзя.
+    if (offset >= m_fileSize) {
+#ifdef _WIN32
+        CloseHandle(file);
+#else
+        ::close(file);
+#endif
+        return false;
+    }
+
+    if (length == 0 || length > m_fileSize - offset)
+        length = m_fileSize - offset;
+
+    std::size_t alignedOffset = offset / granularity * granularity;
+    m_delta = offset - alignedOffset;
+    m_viewSize = m_delta + length;
+    m_size = length;
+
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+        m_view = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(static_cast<unsigned long long>(alignedOffset) >> 32),
+            static_cast<DWORD>(alignedOffset & 0xFFFFFFFFu), m_viewSize);
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    void* view = mmap(nullptr, m_viewSize, PROT_READ, MAP_PRIVATE, file, static_cast<off_t>(alignedOffset));
+    m_view = view != MAP_FAILED ? view : nullptr;
+    ::close(file);
+#endif
+
+    if (!m_view) {
+        m_viewSize = m_delta = m_size = m_fileSize = 0;
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_view) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_view);
+#else
+        munmap(m_view, m_viewSize);
+#endif
+    }
+    m_view = nullptr;
+    m_viewSize = m_delta = m_size = m_fileSize = 0;
+}
+
+bool MappedFile::isOpen() const {
+    return m_view != nullptr;
+}
+
+const unsigned char* MappedFile::getData() const {
+    return m_view ? static_cast<const unsigned char*>(m_view) + m_delta : nullptr;
+}
+
+std::size_t MappedFile::getSize() const {
+    return m_size;
+}
+
+std::size_t MappedFile::getFileSize() const {
+    return m_fileSize;
+}
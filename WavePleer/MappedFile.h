@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Файл, отображенный в память только для чтения.
+// Позволяет читать индекс медиатеки и теги без копирования данных в отдельные буферы.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Отображает в память length байт файла начиная с offset (length = 0 — до конца файла).
+    // offset округляется вниз до границы, которую требует система, но getData() указывает ровно на offset.
+    bool open(const std::string& path, std::size_t offset = 0, std::size_t length = 0);
+    void close();
+
+    bool isOpen() const;
+    const unsigned char* getData() const;
+    std::size_t getSize() const;
+
+    // Полный размер файла, даже если отображена только его часть.
+    std::size_t getFileSize() const;
+
+private:
+    void*       m_view;      // начало отображения (выровненное)
+    std::size_t m_viewSize;
+    std::size_t m_delta;     // смещение запрошенных данных от начала отображения
+    std::size_t m_size;
+    std::size_t m_fileSize;
+};
@@ -0,0 +1,113 @@
+﻿#include "Marquee.h"
+
+#include <algorithm>
+#include <cmath>
+
+Marquee::Marquee()
+    : m_speed(60.f), m_offset(0.f), m_pixel(0) {
+}
+
+void Marquee::setStyle(const sf::Font& font, unsigned int characterSize, sf::Color color, sf::Uint32 style) {
+    m_text.setFont(font);
+    m_text.setCharacterSize(characterSize);
+    m_text.setFillColor(color);
+    m_text.setStyle(style);
+}
+
+void Marquee::setArea(const sf::FloatRect& area) {
+    m_area = area;
+    updateSprite();
+}
+
+void Marquee::setSpeed(float speed) {
+    m_speed = speed;
+}
+
+bool Marquee::setString(const sf::String& string) {
+    if (string == m_text.getString() && m_textSize.x > 0)
+        return false;
+
+    m_text.setString(string);
+    sf::FloatRect bounds = m_text.getLocalBounds();
+    unsigned int maximumSize = sf::Texture::getMaximumSize();
+    m_textSize.x = static_cast<int>(std::min(std::ceil(bounds.left + bounds.width), static_cast<float>(maximumSize)));
+    m_textSize.y = static_cast<int>(std::min(std::ceil(bounds.top + bounds.height), static_cast<float>(maximumSize)));
+
+    // Текстура пересоздается, только если строка в нее не помещается.
+    if (m_textSize.x > 0 && m_textSize.y > 0) {
+        if (static_cast<unsigned int>(m_textSize.x) > m_textureSize.x || static_cast<unsigned int>(m_textSize.y) > m_textureSize.y) {
+            sf::Vector2u size(std::max(m_textureSize.x, static_cast<unsigned int>(m_textSize.x)), std::max(m_textureSize.y, static_cast<unsigned int>(m_textSize.y)));
+            if (m_texture.create(size.x, size.y))
+                m_textureSize = size;
+            else
+                m_textSize = sf::Vector2i();
+        }
+    }
+
+    if (m_textSize.x > 0 && m_textSize.y > 0) {
+        m_texture.clear(sf::Color::Transparent);
+        m_texture.draw(m_text);
+        m_texture.display();
+        m_sprite.setTexture(m_texture.getTexture());
+    }
+
+    // Новая строка начинается с середины области.
+    m_offset = std::floor(m_area.width / 2);
+    m_pixel = static_cast<int>(m_offset);
+    updateSprite();
+    return true;
+}
+
+bool Marquee::update(sf::Time elapsed) {
+    if (m_textSize.x <= 0)
+        return false;
+
+    // Строка уходит влево целиком и снова появляется справа.
+    float cycle = m_area.width + m_textSize.x;
+    float position = std::fmod(m_offset + m_textSize.x - m_speed * elapsed.asSeconds(), cycle);
+    if (position <= 0.f)
+        position += cycle;
+    m_offset = position - m_textSize.x;
+
+    int pixel = static_cast<int>(std::floor(m_offset));
+    if (pixel == m_pixel)
+        return false;
+
+    m_pixel = pixel;
+    updateSprite();
+    return true;
+}
+
+sf::Time Marquee::getTimeToNextStep() const {
+    if (m_speed <= 0.f)
+        return sf::seconds(1.f);
+
+    // До следующего пикселя осталась дробная часть сдвига.
+    float distance = std::max(m_offset - m_pixel, 0.001f);
+    return sf::seconds(distance / m_speed);
+}
+
+sf::FloatRect Marquee::getGlobalBounds() const {
+    return m_sprite.getGlobalBounds();
+}
+
+void Marquee::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+    if (m_sprite.getTextureRect().width > 0)
+        target.draw(m_sprite, states);
+}
+
+void Marquee::updateSprite() {
+    // Обрезаем строку по области: рисуется только видимая часть текстуры.
+    int areaWidth = static_cast<int>(m_area.width);
+    int left = std::max(0, -m_pixel);
+    int right = std::min(m_textSize.x, areaWidth - m_pixel);
+    int height = std::min(m_textSize.y, static_cast<int>(m_area.height));
+    if (right <= left || height <= 0) {
+        m_sprite.setTextureRect(sf::IntRect());
+        m_sprite.setPosition(m_area.left, m_area.top);
+        return;
+    }
+
+    m_sprite.setTextureRect(sf::IntRect(left, 0, right - left, height));
+    m_sprite.setPosition(m_area.left + m_pixel + left, m_area.top);
+}
@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include <SFML/Graphics.hpp>
+
+// Бегущая строка с именем трека.
+// Строка размечается и отрисовывается в текстуру один раз при смене (setString), а кадр только
+// сдвигает прямоугольник этой текстуры, обрезанный по области строки. Поэтому стоимость кадра
+// постоянна, не зависит от длины строки и не требует выделений памяти.
+// Сдвиг считается по прошедшему времени, и скорость не зависит от частоты кадров.
+class Marquee : public sf::Drawable {
+public:
+    Marquee();
+
+    Marquee(const Marquee&) = delete;
+    Marquee& operator=(const Marquee&) = delete;
+
+    void setStyle(const sf::Font& font, unsigned int characterSize, sf::Color color, sf::Uint32 style);
+
+    // Область, по которой бежит строка. Все, что выходит за нее, не рисуется.
+    void setArea(const sf::FloatRect& area);
+
+    // Скорость в пикселях в секунду.
+    void setSpeed(float speed);
+
+    // Размечает строку и отрисовывает ее в текстуру. Возвращает false, если строка не изменилась.
+    bool setString(const sf::String& string);
+
+    // Сдвигает строку на путь за время elapsed. Возвращает true, если она сдвинулась хотя бы на пиксель.
+    bool update(sf::Time elapsed);
+
+    // Через сколько строка сдвинется на следующий пиксель.
+    sf::Time getTimeToNextStep() const;
+
+    // Видимая часть строки (для Scene).
+    sf::FloatRect getGlobalBounds() const;
+
+protected:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+
+private:
+    // Выставляет видимую часть текстуры и ее место по текущему сдвигу.
+    void updateSprite();
+
+    sf::Text          m_text;
+    sf::RenderTexture m_texture;
+    sf::Vector2u      m_textureSize;   // текстура растет, но не пересоздается для каждой строки
+    sf::Vector2i      m_textSize;      // размер строки в текстуре
+    sf::Sprite        m_sprite;
+    sf::FloatRect     m_area;
+    float             m_speed;
+    float             m_offset;        // левый край строки относительно левого края области
+    int               m_pixel;         // сдвиг, с которым строка нарисована сейчас
+};
@@ -0,0 +1,409 @@
+﻿#include "PlaybackEngine.h"
+
+#include <algorithm>
+
+#include "AudioKernels.h"
+
+PlaybackEngine::PlaybackEngine(const Library& library)
+    : m_library(library), m_replayGain(nullptr), m_prefetchedFor(-1), m_prefetchedIndex(-1), m_next(nullptr), m_skip(nullptr),
+      m_staleNext(nullptr),
+      m_currentTrack(-1), m_trackChanged(false), m_waitingForNext(false), m_formatChangePending(false), m_crossfadeMs(0),
+      m_isReplacing(false), m_fadeRemaining(0), m_fadePosition(0.f), m_fadeStep(0.f) {
+    for (auto& slot : m_retired)
+        slot = nullptr;
+}
+
+PlaybackEngine::~PlaybackEngine() {
+    // Поток воспроизведения нужно остановить до разрушения полей, к которым он обращается.
+    stop();
+    delete m_next.exchange(nullptr);
+    delete m_skip.exchange(nullptr);
+    collectRetired();
+}
+
+void PlaybackEngine::playTrack(int trackIndex) {
+    const std::string& path = m_library.getPath(trackIndex);
+    if (path.empty())
+        return;
+
+    // Трек уже открыт и остановлен: просто запускаем его с начала, без повторного открытия.
+    if (getStatus() != Playing && m_current && m_current->getTrackIndex() == trackIndex && !m_formatChangePending) {
+        m_trackLoader.cancel();
+        m_pendingSkip.reset();
+        stop();
+        play();
+        return;
+    }
+
+    m_trackLoader.request(trackIndex, path, m_replayGain ? m_replayGain->getGain(trackIndex) : 1.f);
+}
+
+void PlaybackEngine::stopPlayback() {
+    // Отменяем незавершенное открытие, чтобы трек не заиграл после остановки.
+    m_trackLoader.cancel();
+    m_pendingSkip.reset();
+    stop();
+    delete m_skip.exchange(nullptr);
+    m_waitingForNext = false;
+    m_formatChangePending = false;
+}
+
+bool PlaybackEngine::update() {
+    // Удаляем декодеры, отработавшие в потоке воспроизведения.
+    collectRetired();
+
+    // Трек, выбранный пользователем, открыт.
+    int trackIndex = -1;
+    bool isChanged = false;
+    std::unique_ptr<Decoder> decoder = m_trackLoader.takeReady(trackIndex);
+    if (decoder) {
+        m_pendingSkip = std::move(decoder);
+        isChanged = true;
+    }
+
+    // Поток остановился, не успев забрать выбранный трек: запустим его заново.
+    if (getStatus() == Stopped) {
+        Decoder* skip = m_skip.exchange(nullptr);
+        if (skip && !m_pendingSkip)
+            m_pendingSkip.reset(skip);
+        else
+            delete skip;
+    }
+
+    if (m_pendingSkip) {
+        if (getStatus() == Playing && m_crossfadeMs > 0 && matchesFormat(*m_pendingSkip) && !m_formatChangePending) {
+            // Переход с наложением выполнит поток воспроизведения. Если он еще не забрал прошлый трек, попробуем в следующем кадре.
+            Decoder* expected = nullptr;
+            if (m_skip.compare_exchange_strong(expected, m_pendingSkip.get())) {
+                m_pendingSkip.release();
+                isChanged = true;
+            }
+        }
+        else {
+            startDecoder(std::move(m_pendingSkip));
+            isChanged = true;
+        }
+    }
+
+    // Следующий трек требует другого формата: перезапускаем поток, когда текущий доиграл.
+    if (m_formatChangePending && getStatus() == Stopped) {
+        std::unique_ptr<Decoder> next(m_next.exchange(nullptr));
+        m_staleNext = nullptr;
+        if (next && next->getTrackIndex() == m_library.getNext(m_currentTrack)) {
+            startDecoder(std::move(next));
+            m_trackChanged = true;
+            isChanged = true;
+        }
+        else if (next) {
+            // Пока ждали перезапуска, медиатека изменилась: ждем новый следующий трек.
+            m_waitingForNext = true;
+            isChanged = true;
+        }
+    }
+
+    // Пока поток воспроизведения не забрал выбранный трек, курсор плейлиста еще не сдвинут.
+    if (m_skip.load(std::memory_order_acquire))
+        return isChanged;
+
+    int current = m_currentTrack;
+    if (current < 0)
+        return isChanged;
+
+    // Следующий трек плейлиста меняется и без смены текущего: треки добавляются и удаляются из медиатеки.
+    int nextIndex = m_library.getNext(current);
+
+    // Подготовленный трек больше не следующий. Пока поток воспроизведения работает, забрать его
+    // из m_next может только он, поэтому просим сбросить слот; остановленный поток не мешает удалить сразу
+    // (и отметку, которую он уже не снимет, снимаем сами).
+    // Декодер из m_next удаляет только этот поток, поэтому обращаться к нему здесь безопасно.
+    bool isStopped = getStatus() == Stopped;
+    if (isStopped)
+        m_staleNext = nullptr;
+    Decoder* published = m_next.load(std::memory_order_acquire);
+    if (published && published->getTrackIndex() != nextIndex) {
+        if (isStopped) {
+            delete m_next.exchange(nullptr);
+            isChanged = true;
+        }
+        else if (m_staleNext.exchange(published, std::memory_order_acq_rel) != published) {
+            isChanged = true;
+        }
+    }
+
+    // Заранее открываем следующий трек плейлиста. Медиатека опустела — отменяем запрос.
+    if (nextIndex < 0) {
+        if (m_prefetchedIndex >= 0) {
+            m_prefetchLoader.cancel();
+            m_prefetchedIndex = -1;
+        }
+    }
+    else if (m_prefetchedFor != current || m_prefetchedIndex != nextIndex) {
+        m_prefetchLoader.request(nextIndex, m_library.getPath(nextIndex), m_replayGain ? m_replayGain->getGain(nextIndex) : 1.f);
+        m_prefetchedFor = current;
+        m_prefetchedIndex = nextIndex;
+        isChanged = true;
+    }
+
+    // Публикуем подготовленный трек, когда слот свободен и поток воспроизведения сбросил устаревший.
+    // Иначе трек остается в загрузчике до следующего кадра.
+    if (!m_next.load(std::memory_order_acquire) && !m_staleNext.load(std::memory_order_acquire)) {
+        std::unique_ptr<Decoder> next = m_prefetchLoader.takeReady(trackIndex);
+        if (next && trackIndex == nextIndex) {
+            m_next.store(next.release(), std::memory_order_release);
+            isChanged = true;
+        }
+        else if (next) {
+            // Открыт трек, который уже не следующий: запросим следующий заново.
+            m_prefetchedFor = -1;
+            isChanged = true;
+        }
+    }
+
+    // Следующий трек не удалось открыть: играть больше нечего.
+    if (m_waitingForNext && !m_prefetchLoader.isBusy() && !m_next.load()) {
+        stopPlayback();
+        isChanged = true;
+    }
+
+    return isChanged;
+}
+
+bool PlaybackEngine::takeTrackChange(int& trackIndex) {
+    if (!m_trackChanged.exchange(false))
+        return false;
+
+    trackIndex = m_currentTrack;
+    return true;
+}
+
+bool PlaybackEngine::isIdle() const {
+    return getStatus() == Stopped && !m_trackLoader.isBusy() && !m_pendingSkip && !m_formatChangePending;
+}
+
+void PlaybackEngine::setCrossfade(sf::Time duration) {
+    m_crossfadeMs = std::max(0, std::min(duration.asMilliseconds(), 12000));
+}
+
+sf::Time PlaybackEngine::getCrossfade() const {
+    return sf::milliseconds(m_crossfadeMs);
+}
+
+void PlaybackEngine::setReadAhead(sf::Time readAhead) {
+    m_trackLoader.setReadAhead(readAhead);
+    m_prefetchLoader.setReadAhead(readAhead);
+}
+
+void PlaybackEngine::setReplayGain(ReplayGain* replayGain) {
+    m_replayGain = replayGain;
+}
+
+DspChain& PlaybackEngine::getDsp() {
+    return m_dsp;
+}
+
+bool PlaybackEngine::onGetData(Chunk& data) {
+    const std::size_t size = m_buffer.size();
+    std::size_t filled = 0;
+
+    // UI-поток пометил подготовленный трек как устаревший. Если мы его уже забрали, слот не трогаем.
+    Decoder* stale = m_staleNext.load(std::memory_order_acquire);
+    if (stale) {
+        Decoder* expected = stale;
+        if (m_next.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel))
+            retire(stale);
+        m_staleNext.store(nullptr, std::memory_order_release);
+    }
+
+    // Пользователь выбрал трек того же формата: переходим на него с наложением от текущей позиции.
+    Decoder* skip = m_skip.load(std::memory_order_acquire);
+    if (skip) {
+        m_currentTrack = skip->getTrackIndex();
+
+        // Подготовленный следующий трек относился к прежнему курсору плейлиста.
+        retire(m_next.exchange(nullptr, std::memory_order_acq_rel));
+
+        if (m_incoming) {
+            // Наложение уже идет: прерываем его так же, как обычное переключение трека.
+            retire(m_incoming.release());
+            retire(m_current.release());
+            m_current.reset(skip);
+        }
+        else {
+            beginCrossfade(skip, std::min(getCrossfadeSamples(), m_current->getRemainingSamples()));
+        }
+
+        m_waitingForNext = false;
+        m_skip.store(nullptr, std::memory_order_release);
+    }
+
+    while (m_current && filled < size) {
+        if (m_incoming) {
+            filled += mixCrossfadeBlock(filled, size - filled);
+            continue;
+        }
+
+        std::size_t count = size - filled;
+        Decoder* next = m_next.load(std::memory_order_acquire);
+
+        // Читаем текущий трек только до начала наложения, чтобы оно началось с точностью до сэмпла.
+        std::size_t fadeSamples = next && matchesFormat(*next) ? getCrossfadeSamples() : 0;
+        if (fadeSamples > 0) {
+            std::size_t remaining = m_current->getRemainingSamples();
+            if (remaining <= fadeSamples) {
+                m_next.store(nullptr, std::memory_order_relaxed);
+                m_currentTrack = next->getTrackIndex();
+                m_trackChanged = true;
+                beginCrossfade(next, remaining);
+                continue;
+            }
+            count = std::min(count, remaining - fadeSamples);
+        }
+
+        std::size_t read = m_current->read(m_buffer.data() + filled, count);
+        filled += read;
+        if (read == count)
+            continue;
+
+        // Текущий трек закончился посреди блока: продолжаем блок следующим треком.
+        if (!next) {
+            // Следующий трек еще открывается: дополняем блок тишиной и ждем его.
+            m_waitingForNext = true;
+            std::fill(m_buffer.begin() + filled, m_buffer.end(), static_cast<sf::Int16>(0));
+            filled = size;
+            break;
+        }
+
+        if (!matchesFormat(*next)) {
+            // Без паузы перейти нельзя: доигрываем блок, а поток перезапустит update().
+            m_formatChangePending = true;
+            m_dsp.process(m_buffer.data(), filled);
+            data.samples = m_buffer.data();
+            data.sampleCount = filled;
+            return false;
+        }
+
+        m_next.store(nullptr, std::memory_order_relaxed);
+        retire(m_current.release());
+        m_current.reset(next);
+
+        m_currentTrack = next->getTrackIndex();
+        m_trackChanged = true;
+        m_waitingForNext = false;
+    }
+
+    m_dsp.process(m_buffer.data(), filled);
+    data.samples = m_buffer.data();
+    data.sampleCount = filled;
+    return filled > 0;
+}
+
+void PlaybackEngine::onSeek(sf::Time timeOffset) {
+    // SFML вызывает onSeek из stop(); декодеры, которые сейчас заменят, перематывать незачем.
+    if (m_isReplacing)
+        return;
+
+    // Остановка посреди наложения: текущим становится входящий трек.
+    if (m_incoming)
+        m_current = std::move(m_incoming);
+
+    if (m_current)
+        m_current->seek(timeOffset);
+}
+
+void PlaybackEngine::startDecoder(std::unique_ptr<Decoder> decoder) {
+    // После stop() поток воспроизведения завершен, и к декодерам можно обращаться из UI-потока.
+    m_isReplacing = true;
+    stop();
+    m_isReplacing = false;
+    delete m_next.exchange(nullptr);
+    delete m_skip.exchange(nullptr);
+    m_staleNext = nullptr;
+    collectRetired();
+
+    m_current = std::move(decoder);
+    m_incoming.reset();
+    m_currentTrack = m_current->getTrackIndex();
+    m_prefetchedFor = -1;
+    m_prefetchedIndex = -1;
+    m_waitingForNext = false;
+    m_formatChangePending = false;
+
+    unsigned int channelCount = m_current->getChannelCount();
+    unsigned int sampleRate = m_current->getSampleRate();
+    if (channelCount != getChannelCount() || sampleRate != getSampleRate()) {
+        initialize(channelCount, sampleRate);
+
+        // Блок в 100 мс: буферы выделяются здесь, а не в потоке воспроизведения.
+        m_buffer.assign(static_cast<std::size_t>(sampleRate / 10) * channelCount, 0);
+        m_mixBuffer.assign(m_buffer.size(), 0);
+        m_dsp.prepare(channelCount, sampleRate, m_buffer.size());
+    }
+
+    play();
+}
+
+bool PlaybackEngine::matchesFormat(const Decoder& decoder) const {
+    return decoder.getChannelCount() == getChannelCount() && decoder.getSampleRate() == getSampleRate();
+}
+
+std::size_t PlaybackEngine::getCrossfadeSamples() const {
+    return static_cast<std::size_t>(m_crossfadeMs) * getSampleRate() / 1000 * getChannelCount();
+}
+
+void PlaybackEngine::beginCrossfade(Decoder* incoming, std::size_t fadeSamples) {
+    std::size_t fadeFrames = fadeSamples / getChannelCount();
+
+    // Накладывать нечего: переключаемся сразу.
+    if (fadeFrames == 0) {
+        retire(m_current.release());
+        m_current.reset(incoming);
+        return;
+    }
+
+    m_incoming.reset(incoming);
+    m_fadeRemaining = fadeFrames * getChannelCount();
+    m_fadePosition = 0.f;
+    m_fadeStep = 1.f / static_cast<float>(fadeFrames);
+}
+
+std::size_t PlaybackEngine::mixCrossfadeBlock(std::size_t offset, std::size_t count) {
+    count = std::min(count, m_fadeRemaining);
+
+    // Оба трека читаются в этом же потоке; недостающие сэмплы (трек короче наложения) заменяем тишиной.
+    sf::Int16* outgoing = m_buffer.data() + offset;
+    std::size_t outgoingRead = m_current->read(outgoing, count);
+    std::fill(outgoing + outgoingRead, outgoing + count, static_cast<sf::Int16>(0));
+
+    std::size_t incomingRead = m_incoming->read(m_mixBuffer.data(), count);
+    std::fill(m_mixBuffer.begin() + incomingRead, m_mixBuffer.begin() + count, static_cast<sf::Int16>(0));
+
+    mixCrossfade(outgoing, m_mixBuffer.data(), outgoing, count, getChannelCount(), m_fadePosition, m_fadeStep);
+    m_fadePosition += m_fadeStep * static_cast<float>(count / getChannelCount());
+    m_fadeRemaining -= count;
+
+    // Наложение закончилось: входящий трек становится текущим.
+    if (m_fadeRemaining == 0) {
+        retire(m_current.release());
+        m_current = std::move(m_incoming);
+    }
+
+    return count;
+}
+
+void PlaybackEngine::retire(Decoder* decoder) {
+    if (!decoder)
+        return;
+
+    // Закрытие файла, остановка потока декодера и освобождение памяти выполняет UI-поток в update().
+    // Свободный слот есть всегда (см. RetiredSlotCount), сколько бы UI-поток ни задерживался.
+    for (auto& slot : m_retired) {
+        Decoder* expected = nullptr;
+        if (slot.compare_exchange_strong(expected, decoder))
+            return;
+    }
+}
+
+void PlaybackEngine::collectRetired() {
+    for (auto& slot : m_retired)
+        delete slot.exchange(nullptr);
+}
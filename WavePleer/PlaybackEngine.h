@@ -0,0 +1,126 @@
+﻿#pragma once
+
+#include <SFML/Audio.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Decoder.h"
+#include "DspChain.h"
+#include "Library.h"
+#include "ReplayGain.h"
+#include "TrackLoader.h"
+
+// Движок воспроизведения без пауз между треками.
+// Владеет курсором плейлиста: следующий трек открывается и подготавливается заранее,
+// а переход на него происходит внутри одного блока сэмплов в onGetData.
+// При включенном наложении (crossfade) конец текущего трека смешивается с началом следующего.
+//
+// Потоки:
+//  - UI-поток вызывает playTrack/stopPlayback/update;
+//  - поток SFML вызывает onGetData и обращается только к m_current, m_incoming и атомарным полям.
+//  - у каждого декодера свой поток, который декодирует трек впрок, поэтому onGetData только копирует готовые сэмплы.
+// Слоты m_next и m_skip UI-поток заполняет только пустыми, а освобождает их поток воспроизведения.
+// Устаревший m_next (медиатека изменилась) UI-поток только помечает в m_staleNext, а сбрасывает его поток воспроизведения.
+class PlaybackEngine : public sf::SoundStream {
+public:
+    explicit PlaybackEngine(const Library& library);
+    ~PlaybackEngine();
+
+    // Запускает трек с указанным индексом. Трек открывается в фоне.
+    void playTrack(int trackIndex);
+
+    // Останавливает воспроизведение и отменяет незавершенное открытие.
+    void stopPlayback();
+
+    // Вызывается из UI-потока каждый кадр: запускает открытые треки и готовит следующий.
+    // Возвращает true, если что-то изменилось: трек запущен или остановлен, следующий запрошен или готов.
+    bool update();
+
+    // Сообщает о переходе на следующий трек, произошедшем в потоке воспроизведения.
+    bool takeTrackChange(int& trackIndex);
+
+    // Ничего не играет и не открывается: update можно не вызывать до следующего playTrack.
+    bool isIdle() const;
+
+    // Длительность наложения треков, от 0 до 12 секунд. Ноль — переход без паузы и без смешивания.
+    void setCrossfade(sf::Time duration);
+    sf::Time getCrossfade() const;
+
+    // На сколько поток декодера забегает вперед воспроизведения. Действует на треки, открытые после вызова.
+    void setReadAhead(sf::Time readAhead);
+
+    // Источник усиления треков (ReplayGain). Действует на треки, открытые после вызова; nullptr — без усиления.
+    void setReplayGain(ReplayGain* replayGain);
+
+    // Цепочка обработки, через которую проходит каждый блок перед OpenAL.
+    // Узлы добавляются до первого playTrack, параметры меняются в любой момент.
+    DspChain& getDsp();
+
+protected:
+    bool onGetData(Chunk& data) override;
+    void onSeek(sf::Time timeOffset) override;
+
+private:
+    // Останавливает поток, подменяет текущий декодер и запускает воспроизведение (UI-поток).
+    void startDecoder(std::unique_ptr<Decoder> decoder);
+
+    // Совпадает ли формат декодера с форматом потока.
+    bool matchesFormat(const Decoder& decoder) const;
+
+    // Длительность наложения в сэмплах с учетом каналов (поток воспроизведения).
+    std::size_t getCrossfadeSamples() const;
+
+    // Начинает наложение входящего трека на текущий длиной fadeSamples (поток воспроизведения).
+    void beginCrossfade(Decoder* incoming, std::size_t fadeSamples);
+
+    // Смешивает очередную часть наложения в m_buffer. Возвращает число записанных сэмплов.
+    std::size_t mixCrossfadeBlock(std::size_t offset, std::size_t count);
+
+    // Передает отработавший декодер UI-потоку для удаления (поток воспроизведения).
+    void retire(Decoder* decoder);
+
+    // Удаляет отработавшие декодеры (UI-поток).
+    void collectRetired();
+
+    // Сколько декодеров поток воспроизведения может отдать между двумя collectRetired.
+    // Новые декодеры он получает только через m_next и m_skip, а их update заполняет уже после
+    // collectRetired, по одному разу. Значит, за это время через поток проходят не больше шести
+    // декодеров (текущий, входящий, m_next и m_skip, а также m_next и m_skip, опубликованные этим
+    // же update), и один из них остается текущим. Поэтому слоты не переполняются, и удалять
+    // декодер в потоке воспроизведения не приходится никогда.
+    static const std::size_t RetiredSlotCount = 5;
+
+    const Library&           m_library;
+    ReplayGain*              m_replayGain;
+
+    TrackLoader              m_trackLoader;    // трек, выбранный пользователем
+    TrackLoader              m_prefetchLoader; // следующий трек плейлиста
+    int                      m_prefetchedFor;  // трек, для которого запрошен следующий
+    int                      m_prefetchedIndex; // какой трек запрошен следующим
+    std::unique_ptr<Decoder> m_pendingSkip;    // открытый трек, который еще не передан потоку воспроизведения
+
+    std::unique_ptr<Decoder> m_current;        // принадлежит потоку воспроизведения, пока он запущен
+    std::unique_ptr<Decoder> m_incoming;       // входящий трек во время наложения
+    std::atomic<Decoder*>    m_next;           // подготовленный следующий трек
+    std::atomic<Decoder*>    m_skip;           // выбранный пользователем трек для перехода с наложением
+    std::atomic<Decoder*>    m_staleNext;      // m_next, который больше не следующий; пока он задан, m_next не заполняется
+    std::atomic<Decoder*>    m_retired[RetiredSlotCount]; // отработавшие декодеры, ожидающие удаления
+
+    std::atomic<int>         m_currentTrack;
+    std::atomic<bool>        m_trackChanged;
+    std::atomic<bool>        m_waitingForNext;      // трек закончился, а следующий еще не готов
+    std::atomic<bool>        m_formatChangePending; // следующий трек требует другого формата потока
+    std::atomic<sf::Int32>   m_crossfadeMs;
+    bool                     m_isReplacing;    // startDecoder останавливает поток, чтобы заменить декодеры (UI-поток)
+
+    // Состояние наложения (поток воспроизведения).
+    std::size_t              m_fadeRemaining;  // сколько сэмплов наложения осталось
+    float                    m_fadePosition;   // текущая громкость входящего трека
+    float                    m_fadeStep;       // прирост громкости за кадр
+
+    DspChain                 m_dsp;
+    std::vector<sf::Int16>   m_buffer;
+    std::vector<sf::Int16>   m_mixBuffer;      // сэмплы входящего трека во время наложения
+};
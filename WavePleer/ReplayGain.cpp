@@ -0,0 +1,231 @@
+﻿#include "ReplayGain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+namespace {
+    const char CacheMagic[4] = { 'W', 'P', 'L', 'N' };
+    const std::uint32_t CacheVersion = 1;
+
+    struct CacheRecord {
+        std::uint64_t id;
+        float         integrated;
+        float         truePeak;
+        std::uint32_t duration;
+        std::uint32_t flags;
+    };
+
+    // Файл не удалось декодировать: повторно его не анализируем, пока он не изменится.
+    const std::uint32_t FailedFlag = 1;
+
+    const float ReferenceLoudness = -18.f;
+
+    // Усиление не поднимает истинный пик выше -1 dBTP, чтобы не было перегрузки.
+    const float PeakCeiling = -1.f;
+
+    float toGain(float loudness, float truePeak) {
+        float decibels = std::min(ReferenceLoudness - loudness, PeakCeiling - truePeak);
+        return std::pow(10.f, decibels / 20.f);
+    }
+}
+
+ReplayGain::ReplayGain(const Library& library)
+    : m_library(library), m_mode(Track) {
+}
+
+void ReplayGain::load(const std::string& path) {
+    m_path = path;
+
+    // Оборванная последняя запись (сбой во время дописывания) пропускается.
+    bool isValid = false;
+    {
+        std::ifstream file(path, std::ios::binary);
+        char magic[4];
+        std::uint32_t version = 0;
+        if (file.read(magic, sizeof(magic)) && file.read(reinterpret_cast<char*>(&version), sizeof(version)) &&
+            std::memcmp(magic, CacheMagic, sizeof(magic)) == 0 && version == CacheVersion) {
+            isValid = true;
+            CacheRecord record;
+            while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+                if (record.flags & FailedFlag) {
+                    m_failed.insert(record.id);
+                    continue;
+                }
+
+                LoudnessInfo info;
+                info.integrated = record.integrated;
+                info.truePeak = record.truePeak;
+                info.duration = record.duration;
+                m_entries[record.id] = info;
+            }
+        }
+    }
+
+    if (isValid) {
+        // Обрезаем оборванную запись, чтобы новые записи легли ровно.
+        std::error_code error;
+        const std::uintmax_t header = sizeof(CacheMagic) + sizeof(CacheVersion);
+        std::uintmax_t size = std::filesystem::file_size(path, error);
+        if (!error && (size - header) % sizeof(CacheRecord) != 0)
+            std::filesystem::resize_file(path, header + (size - header) / sizeof(CacheRecord) * sizeof(CacheRecord), error);
+        m_file.open(path, std::ios::binary | std::ios::app);
+    }
+    else {
+        // Кэша нет или он старого формата: начинаем заново.
+        m_entries.clear();
+        m_failed.clear();
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        m_file.write(CacheMagic, sizeof(CacheMagic));
+        m_file.write(reinterpret_cast<const char*>(&CacheVersion), sizeof(CacheVersion));
+        m_file.flush();
+    }
+
+    if (!m_file.is_open())
+        std::cerr << "Failed to open loudness cache for writing: " << path << std::endl;
+}
+
+void ReplayGain::requestMissing(LoudnessAnalyzer& analyzer) {
+    for (int index = 0; index < static_cast<int>(m_library.getSize()); ++index)
+        requestTrack(index, analyzer);
+}
+
+void ReplayGain::requestMissing(const std::vector<int>& trackIndices, LoudnessAnalyzer& analyzer) {
+    for (int index : trackIndices)
+        requestTrack(index, analyzer);
+}
+
+bool ReplayGain::update(LoudnessAnalyzer& analyzer) {
+    if (!analyzer.takeResults(m_results))
+        return false;
+
+    for (const auto& result : m_results) {
+        m_requested.erase(result.id);
+        if (result.isValid)
+            add(result.id, result.info);
+        else
+            addFailed(result.id);
+    }
+    m_results.clear();
+    return true;
+}
+
+void ReplayGain::updateAlbums() {
+    for (int index = 0; index < static_cast<int>(m_library.getSize()); ++index)
+        updateAlbum(index);
+}
+
+void ReplayGain::updateAlbums(const std::vector<int>& trackIndices) {
+    for (int index : trackIndices)
+        updateAlbum(index);
+}
+
+void ReplayGain::setMode(Mode mode) {
+    m_mode = mode;
+}
+
+ReplayGain::Mode ReplayGain::getMode() const {
+    return m_mode;
+}
+
+float ReplayGain::getGain(int trackIndex) const {
+    if (m_mode == Off)
+        return 1.f;
+
+    auto found = m_entries.find(m_library.getInfo(trackIndex).id);
+    if (found == m_entries.end())
+        return 1.f;
+
+    int album = trackIndex < static_cast<int>(m_trackAlbums.size()) ? m_trackAlbums[trackIndex] : -1;
+    if (m_mode == Album && album >= 0) {
+        // Громкость альбома — средняя мощность его измеренных треков с весом по длительности.
+        double energy = 0.0;
+        double duration = 0.0;
+        float truePeak = -120.f;
+        for (int index : m_albums[album]) {
+            // Удаленный трек остается в списке альбома, пока запись не займет новый трек.
+            if (m_library.getPath(index).empty())
+                continue;
+
+            auto entry = m_entries.find(m_library.getInfo(index).id);
+            if (entry == m_entries.end())
+                continue;
+
+            const LoudnessInfo& info = entry->second;
+            energy += info.duration * std::pow(10.0, info.integrated / 10.0);
+            duration += info.duration;
+            truePeak = std::max(truePeak, info.truePeak);
+        }
+
+        if (duration > 0.0)
+            return toGain(static_cast<float>(10.0 * std::log10(energy / duration)), truePeak);
+    }
+
+    return toGain(found->second.integrated, found->second.truePeak);
+}
+
+void ReplayGain::add(std::uint64_t id, const LoudnessInfo& info) {
+    m_entries[id] = info;
+    write(id, info, 0);
+}
+
+void ReplayGain::addFailed(std::uint64_t id) {
+    m_failed.insert(id);
+    write(id, LoudnessInfo(), FailedFlag);
+}
+
+void ReplayGain::write(std::uint64_t id, const LoudnessInfo& info, std::uint32_t flags) {
+    if (!m_file.is_open())
+        return;
+
+    CacheRecord record = {};
+    record.id = id;
+    record.integrated = info.integrated;
+    record.truePeak = info.truePeak;
+    record.duration = info.duration;
+    record.flags = flags;
+    m_file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    m_file.flush();
+}
+
+void ReplayGain::requestTrack(int trackIndex, LoudnessAnalyzer& analyzer) {
+    std::uint64_t id = m_library.getInfo(trackIndex).id;
+    if (id == 0 || m_entries.find(id) != m_entries.end() || m_failed.find(id) != m_failed.end())
+        return;
+    if (m_requested.insert(id).second)
+        analyzer.request(id, m_library.getPath(trackIndex));
+}
+
+void ReplayGain::updateAlbum(int trackIndex) {
+    if (trackIndex >= static_cast<int>(m_trackAlbums.size()))
+        m_trackAlbums.resize(m_library.getSize(), -1);
+
+    int album = -1;
+    std::string key = getAlbumKey(trackIndex);
+    if (!key.empty())
+        album = m_albumSlots.emplace(std::move(key), static_cast<int>(m_albums.size())).first->second;
+    if (album == static_cast<int>(m_albums.size()))
+        m_albums.emplace_back();
+
+    // Трек сменил альбом (изменились теги или запись заняла другой трек): переносим его.
+    int& current = m_trackAlbums[trackIndex];
+    if (current == album)
+        return;
+    if (current >= 0) {
+        std::vector<int>& tracks = m_albums[current];
+        tracks.erase(std::find(tracks.begin(), tracks.end(), trackIndex));
+    }
+    if (album >= 0)
+        m_albums[album].push_back(trackIndex);
+    current = album;
+}
+
+std::string ReplayGain::getAlbumKey(int trackIndex) const {
+    const std::string& album = m_library.getInfo(trackIndex).album;
+    if (album.empty())
+        return std::string();
+    return std::filesystem::path(m_library.getPath(trackIndex)).parent_path().string() + '\n' + album;
+}
@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Library.h"
+#include "LoudnessAnalyzer.h"
+
+// Выравнивание громкости треков (ReplayGain 2.0, опорная громкость -18 LUFS).
+// Громкость измеряет LoudnessAnalyzer, результаты хранятся в кэше по идентификатору трека
+// (loudness.cache) и дописываются в него по одной записи, так что анализ каждого трека
+// выполняется один раз, даже если файл переименовали.
+// Усиление применяет декодер при открытии трека, поэтому поток воспроизведения ничего не пересчитывает.
+// Все методы вызываются из UI-потока.
+class ReplayGain {
+public:
+    enum Mode {
+        Off,
+        Track,   // каждый трек к опорной громкости
+        Album    // весь альбом одним усилением, чтобы сохранить разницу громкости между его треками
+    };
+
+    explicit ReplayGain(const Library& library);
+
+    // Читает кэш и открывает его для дописывания.
+    void load(const std::string& path);
+
+    // Ставит в очередь анализа треки медиатеки, которых нет в кэше. Обходит всю медиатеку.
+    void requestMissing(LoudnessAnalyzer& analyzer);
+
+    // То же для указанных треков: добавленных или измененных с прошлого кадра.
+    void requestMissing(const std::vector<int>& trackIndices, LoudnessAnalyzer& analyzer);
+
+    // Забирает результаты анализа. Возвращает true, если они были.
+    bool update(LoudnessAnalyzer& analyzer);
+
+    // Распределяет треки медиатеки по альбомам. Обходит всю медиатеку.
+    void updateAlbums();
+
+    // То же для указанных треков: добавленных или измененных с прошлого кадра.
+    // Удаленные треки сообщать не нужно: getGain их пропускает.
+    void updateAlbums(const std::vector<int>& trackIndices);
+
+    void setMode(Mode mode);
+    Mode getMode() const;
+
+    // Линейное усиление трека. 1, если выравнивание выключено или трек еще не измерен.
+    // Громкость альбома считается по его трекам при каждом вызове, поэтому результаты анализа
+    // и изменения медиатеки не требуют пересчета: вызов стоит O(размер альбома).
+    float getGain(int trackIndex) const;
+
+private:
+    void add(std::uint64_t id, const LoudnessInfo& info);
+    void addFailed(std::uint64_t id);
+    void write(std::uint64_t id, const LoudnessInfo& info, std::uint32_t flags);
+    void requestTrack(int trackIndex, LoudnessAnalyzer& analyzer);
+    void updateAlbum(int trackIndex);
+
+    // Ключ альбома: каталог и тег альбома. Пустая строка — трек вне альбома.
+    std::string getAlbumKey(int trackIndex) const;
+
+    const Library&                                   m_library;
+    Mode                                             m_mode;
+    std::string                                      m_path;
+    std::ofstream                                    m_file;
+    std::unordered_map<std::uint64_t, LoudnessInfo>  m_entries;
+    std::unordered_set<std::uint64_t>                m_requested;
+    std::unordered_set<std::uint64_t>                m_failed;    // файлы, которые не удалось декодировать
+    std::unordered_map<std::string, int>             m_albumSlots;  // ключ альбома -> номер в m_albums
+    std::vector<std::vector<int>>                    m_albums;      // треки каждого альбома
+    std::vector<int>                                 m_trackAlbums; // номер альбома трека или -1
+    std::vector<LoudnessAnalyzer::Result>            m_results;
+};
@@ -0,0 +1,63 @@
+﻿#include "SampleRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+SampleRing::SampleRing()
+    : m_writePosition(0), m_readPosition(0) {
+}
+
+void SampleRing::allocate(std::size_t capacity) {
+    m_buffer.assign(capacity, 0);
+    reset();
+}
+
+void SampleRing::reset() {
+    m_writePosition.store(0, std::memory_order_relaxed);
+    m_readPosition.store(0, std::memory_order_relaxed);
+}
+
+std::size_t SampleRing::getCapacity() const {
+    return m_buffer.size();
+}
+
+std::size_t SampleRing::getWritable(sf::Int16*& data) {
+    std::size_t write = m_writePosition.load(std::memory_order_relaxed);
+    std::size_t read = m_readPosition.load(std::memory_order_acquire);
+    std::size_t free = m_buffer.size() - (write - read);
+
+    // Свободное место может переходить через конец буфера: отдаем часть до конца.
+    std::size_t offset = write % m_buffer.size();
+    data = m_buffer.data() + offset;
+    return std::min(free, m_buffer.size() - offset);
+}
+
+void SampleRing::commit(std::size_t count) {
+    m_writePosition.store(m_writePosition.load(std::memory_order_relaxed) + count, std::memory_order_release);
+}
+
+std::size_t SampleRing::read(sf::Int16* samples, std::size_t count) {
+    std::size_t read = m_readPosition.load(std::memory_order_relaxed);
+    std::size_t write = m_writePosition.load(std::memory_order_acquire);
+    count = std::min(count, write - read);
+    if (count == 0)
+        return 0;
+
+    std::size_t offset = read % m_buffer.size();
+    std::size_t first = std::min(count, m_buffer.size() - offset);
+    std::memcpy(samples, m_buffer.data() + offset, first * sizeof(sf::Int16));
+    std::memcpy(samples + first, m_buffer.data(), (count - first) * sizeof(sf::Int16));
+    m_readPosition.store(read + count, std::memory_order_release);
+    return count;
+}
+
+std::size_t SampleRing::skip(std::size_t count) {
+    std::size_t read = m_readPosition.load(std::memory_order_relaxed);
+    count = std::min(count, m_writePosition.load(std::memory_order_acquire) - read);
+    m_readPosition.store(read + count, std::memory_order_release);
+    return count;
+}
+
+std::size_t SampleRing::getAvailable() const {
+    return m_writePosition.load(std::memory_order_acquire) - m_readPosition.load(std::memory_order_acquire);
+}
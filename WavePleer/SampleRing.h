@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <SFML/Config.hpp>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Кольцевой буфер сэмплов для одного писателя и одного читателя без блокировок.
+// Позиции чтения и записи только растут; каждую меняет лишь ее владелец, а другая сторона
+// читает ее с acquire, поэтому обе операции завершаются за конечное число шагов и не выделяют память.
+// Писатель пишет прямо в свободную часть буфера (getWritable/commit), читатель копирует данные в свой блок.
+class SampleRing {
+public:
+    SampleRing();
+
+    // Выделяет буфер. Вызывается, пока ни писатель, ни читатель не работают.
+    void allocate(std::size_t capacity);
+    // Опустошает буфер. Вызывается писателем, пока читатель к буферу не обращается.
+    void reset();
+
+    std::size_t getCapacity() const;
+
+    // Писатель: непрерывная свободная часть буфера и ее размер.
+    std::size_t getWritable(sf::Int16*& data);
+    // Писатель: публикует count сэмплов, записанных в getWritable.
+    void commit(std::size_t count);
+
+    // Читатель: копирует до count сэмплов. Возвращает число скопированных.
+    std::size_t read(sf::Int16* samples, std::size_t count);
+    // Читатель: пропускает до count сэмплов. Возвращает число пропущенных.
+    std::size_t skip(std::size_t count);
+
+    // Сколько сэмплов ждет читателя.
+    std::size_t getAvailable() const;
+
+private:
+    std::vector<sf::Int16> m_buffer;
+
+    // Позиции на разных строках кэша, чтобы писатель и читатель не мешали друг другу.
+    alignas(64) std::atomic<std::size_t> m_writePosition;
+    alignas(64) std::atomic<std::size_t> m_readPosition;
+};
@@ -0,0 +1,119 @@
+﻿#include "Scene.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Запас вокруг объекта: сглаженные края текстур и глифов выходят за границы на пиксель.
+    const float RegionMargin = 2.f;
+}
+
+Scene::Scene(sf::Vector2u size, sf::Color background)
+    : m_size(size), m_background(background), m_isCached(false), m_isFullRedraw(true) {
+    m_isCached = m_texture.create(size.x, size.y);
+    m_clearShape.setFillColor(background);
+    if (m_isCached)
+        m_cacheSprite.setTexture(m_texture.getTexture(), true);
+}
+
+void Scene::invalidate(const sf::Drawable& object) {
+    for (auto& node : m_nodes) {
+        if (node.object == &object)
+            node.isDirty = true;
+    }
+}
+
+void Scene::invalidateAll() {
+    m_isFullRedraw = true;
+}
+
+void Scene::render(sf::RenderTarget& target) {
+    // Без sf::RenderTexture рисуем сцену прямо в окно, как обычно.
+    if (!m_isCached) {
+        target.clear(m_background);
+        for (auto& node : m_nodes) {
+            target.draw(*node.object);
+            node.bounds = node.getBounds(*node.object);
+            node.isDirty = false;
+        }
+        return;
+    }
+
+    // Изменившийся объект перерисовывается и на старом месте (там теперь фон), и на новом.
+    m_regions.clear();
+    for (auto& node : m_nodes) {
+        if (!node.isDirty)
+            continue;
+        sf::FloatRect bounds = node.getBounds(*node.object);
+        if (!m_isFullRedraw) {
+            addRegion(node.bounds);
+            addRegion(bounds);
+        }
+        node.bounds = bounds;
+        node.isDirty = false;
+    }
+    if (m_isFullRedraw) {
+        m_regions.clear();
+        m_regions.push_back(sf::FloatRect(0.f, 0.f, static_cast<float>(m_size.x), static_cast<float>(m_size.y)));
+        m_isFullRedraw = false;
+    }
+
+    if (!m_regions.empty()) {
+        for (const auto& region : m_regions)
+            renderRegion(m_texture, region);
+        m_texture.setView(m_texture.getDefaultView());
+        m_texture.display();
+    }
+
+    // Кэш непрозрачен и закрывает окно целиком, поэтому очищать окно не нужно.
+    target.draw(m_cacheSprite);
+}
+
+void Scene::addRegion(sf::FloatRect region) {
+    if (region.width <= 0.f || region.height <= 0.f)
+        return;
+
+    // Выравниваем по пикселям с запасом и обрезаем по размеру кэша.
+    float left = std::max(0.f, std::floor(region.left - RegionMargin));
+    float top = std::max(0.f, std::floor(region.top - RegionMargin));
+    float right = std::min(static_cast<float>(m_size.x), std::ceil(region.left + region.width + RegionMargin));
+    float bottom = std::min(static_cast<float>(m_size.y), std::ceil(region.top + region.height + RegionMargin));
+    if (right <= left || bottom <= top)
+        return;
+    region = sf::FloatRect(left, top, right - left, bottom - top);
+
+    // Пересекающиеся области объединяем, чтобы не рисовать одни и те же пиксели дважды.
+    for (std::size_t i = 0; i < m_regions.size();) {
+        if (!m_regions[i].intersects(region)) {
+            ++i;
+            continue;
+        }
+        float unionLeft = std::min(region.left, m_regions[i].left);
+        float unionTop = std::min(region.top, m_regions[i].top);
+        float unionRight = std::max(region.left + region.width, m_regions[i].left + m_regions[i].width);
+        float unionBottom = std::max(region.top + region.height, m_regions[i].top + m_regions[i].height);
+        region = sf::FloatRect(unionLeft, unionTop, unionRight - unionLeft, unionBottom - unionTop);
+
+        // Объединенная область могла задеть уже просмотренные: начинаем сначала.
+        m_regions[i] = m_regions.back();
+        m_regions.pop_back();
+        i = 0;
+    }
+    m_regions.push_back(region);
+}
+
+void Scene::renderRegion(sf::RenderTarget& target, const sf::FloatRect& region) {
+    // Вид с областью просмотра, равной области, отсекает все, что за ее пределами.
+    sf::View view(region);
+    view.setViewport(sf::FloatRect(region.left / m_size.x, region.top / m_size.y, region.width / m_size.x, region.height / m_size.y));
+    target.setView(view);
+
+    m_clearShape.setPosition(region.left, region.top);
+    m_clearShape.setSize(sf::Vector2f(region.width, region.height));
+    target.draw(m_clearShape);
+
+    for (const auto& node : m_nodes) {
+        if (node.bounds.intersects(region))
+            target.draw(*node.object);
+    }
+}
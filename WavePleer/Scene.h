@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+// Сохраняемая сцена окна плеера.
+// Сцена помнит объекты интерфейса (спрайты, текст, фигуры) в порядке отрисовки и держит готовое
+// изображение окна в sf::RenderTexture. Код, изменивший объект, вызывает invalidate, и при следующем
+// render перерисовываются только области, которые объект занимал до и после изменения.
+// Остальное окно каждый кадр выводится из кэша одним прямоугольником.
+//
+// Объекты принадлежат вызывающему коду и должны жить дольше сцены.
+class Scene {
+public:
+    Scene(sf::Vector2u size, sf::Color background);
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // Добавляет объект поверх уже добавленных. T — любой объект SFML с getGlobalBounds.
+    template <typename T>
+    void add(const T& object) {
+        m_nodes.push_back(Node{ &object, &getBoundsOf<T>, object.getGlobalBounds(), true });
+    }
+
+    // Объект изменился (положение, цвет, текстура, строка): его область будет перерисована.
+    void invalidate(const sf::Drawable& object);
+
+    // Перерисовать все окно, например после изменения его размера.
+    void invalidateAll();
+
+    // Перерисовывает изменившиеся области кэша и выводит его в окно (без display).
+    void render(sf::RenderTarget& target);
+
+private:
+    typedef sf::FloatRect (*BoundsFunction)(const sf::Drawable& object);
+
+    struct Node {
+        const sf::Drawable* object;
+        BoundsFunction      getBounds;
+        sf::FloatRect       bounds;      // место объекта на момент последней отрисовки
+        bool                isDirty;
+    };
+
+    template <typename T>
+    static sf::FloatRect getBoundsOf(const sf::Drawable& object) {
+        return static_cast<const T&>(object).getGlobalBounds();
+    }
+
+    // Добавляет область к перерисовываемым, объединяя ее с пересекающимися.
+    void addRegion(sf::FloatRect region);
+
+    // Заново рисует в кэше все объекты, попадающие в область.
+    void renderRegion(sf::RenderTarget& target, const sf::FloatRect& region);
+
+    sf::Vector2u               m_size;
+    sf::Color                  m_background;
+    sf::RenderTexture          m_texture;
+    bool                       m_isCached;       // удалось ли создать sf::RenderTexture
+    bool                       m_isFullRedraw;
+    std::vector<Node>          m_nodes;
+    std::vector<sf::FloatRect> m_regions;        // перерисовываемые области текущего кадра
+    sf::RectangleShape         m_clearShape;
+    sf::Sprite                 m_cacheSprite;
+};
@@ -0,0 +1,1052 @@
+﻿#include "TagReader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string_view>
+
+#include "MappedFile.h"
+
+namespace {
+    // Окно, которым отображается начало файла и каждый следующий участок.
+    // Теги, заголовок первого кадра и заголовки страниц Ogg обычно помещаются в одно окно.
+    const std::size_t WindowSize = 64 * 1024;
+
+    // Сколько байт за тегом ID3v2 просматривается в поисках первого кадра MPEG.
+    const std::size_t SyncSearchSize = 64 * 1024;
+
+    // Сколько байт в начале поля комментария Vorbis хватает, чтобы узнать ключ.
+    const std::size_t CommentKeySize = 16;
+
+    // Окно в файл: отображает нужный участок по требованию и не трогает остальное.
+    // Указатель действителен до следующего вызова map().
+    class FileWindow {
+    public:
+        explicit FileWindow(const std::string& path)
+            : m_path(path), m_offset(0), m_fileSize(0) {
+        }
+
+        bool open() {
+            if (!m_file.open(m_path, 0, WindowSize))
+                return false;
+            m_fileSize = m_file.getFileSize();
+            return true;
+        }
+
+        // length байт начиная с offset или nullptr, если они выходят за конец файла.
+        const unsigned char* map(std::uint64_t offset, std::size_t length) {
+            if (length == 0 || length > m_fileSize || offset > m_fileSize - length)
+                return nullptr;
+
+            if (!m_file.isOpen() || offset < m_offset || offset + length > m_offset + m_file.getSize()) {
+                // Захватываем целое окно: следующие поля, скорее всего, лежат рядом.
+                if (!m_file.open(m_path, static_cast<std::size_t>(offset), std::max(length, WindowSize)))
+                    return nullptr;
+                m_offset = offset;
+            }
+            return m_file.getData() + (offset - m_offset);
+        }
+
+        std::uint64_t getFileSize() const {
+            return m_fileSize;
+        }
+
+    private:
+        std::string   m_path;
+        MappedFile    m_file;
+        std::uint64_t m_offset;   // смещение getData() в файле
+        std::uint64_t m_fileSize;
+    };
+
+    std::uint32_t readBigEndian32(const unsigned char* data) {
+        return (static_cast<std::uint32_t>(data[0]) << 24) | (static_cast<std::uint32_t>(data[1]) << 16) |
+            (static_cast<std::uint32_t>(data[2]) << 8) | data[3];
+    }
+
+    std::uint32_t readLittleEndian32(const unsigned char* data) {
+        return (static_cast<std::uint32_t>(data[3]) << 24) | (static_cast<std::uint32_t>(data[2]) << 16) |
+            (static_cast<std::uint32_t>(data[1]) << 8) | data[0];
+    }
+
+    std::uint64_t readLittleEndian64(const unsigned char* data) {
+        return (static_cast<std::uint64_t>(readLittleEndian32(data + 4)) << 32) | readLittleEndian32(data);
+    }
+
+    // Целое ID3v2, в котором старший бит каждого байта равен нулю.
+    std::uint32_t readSyncSafe32(const unsigned char* data) {
+        return (static_cast<std::uint32_t>(data[0] & 0x7F) << 21) | (static_cast<std::uint32_t>(data[1] & 0x7F) << 14) |
+            (static_cast<std::uint32_t>(data[2] & 0x7F) << 7) | (data[3] & 0x7F);
+    }
+
+    std::uint32_t toMilliseconds(std::uint64_t samples, std::uint32_t sampleRate) {
+        return sampleRate ? static_cast<std::uint32_t>(samples * 1000 / sampleRate) : 0;
+    }
+
+    void appendUtf8(std::string& text, std::uint32_t code) {
+        if (code < 0x80) {
+            text += static_cast<char>(code);
+        }
+        else if (code < 0x800) {
+            text += static_cast<char>(0xC0 | (code >> 6));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000) {
+            text += static_cast<char>(0xE0 | (code >> 12));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else {
+            text += static_cast<char>(0xF0 | (code >> 18));
+            text += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool isValidUtf8(std::string_view text) {
+        for (std::size_t i = 0; i < text.size();) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            std::size_t length = c < 0x80 ? 1 : (c >> 5) == 0x06 ? 2 : (c >> 4) == 0x0E ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+            if (length == 0 || i + length > text.size())
+                return false;
+            for (std::size_t j = 1; j < length; ++j) {
+                if ((static_cast<unsigned char>(text[i + j]) & 0xC0) != 0x80)
+                    return false;
+            }
+            i += length;
+        }
+        return true;
+    }
+
+    // Обрезает строку по первому нулю и убирает пробелы в конце (поля ID3v1 и RIFF дополняются ими).
+    std::string_view trimText(std::string_view text) {
+        text = text.substr(0, text.find('\0'));
+        while (!text.empty() && text.back() == ' ')
+            text.remove_suffix(1);
+        return text;
+    }
+
+    // Однобайтовый текст: ISO-8859-1 по стандарту, но многие программы пишут туда UTF-8.
+    std::string singleByteToUtf8(std::string_view text) {
+        text = trimText(text);
+        if (isValidUtf8(text))
+            return std::string(text);
+
+        std::string result;
+        result.reserve(text.size() * 2);
+        for (char c : text)
+            appendUtf8(result, static_cast<unsigned char>(c));
+        return result;
+    }
+
+    std::string utf16ToUtf8(const unsigned char* data, std::size_t size, bool bigEndian) {
+        std::string result;
+        for (std::size_t i = 0; i + 1 < size; i += 2) {
+            std::uint32_t code = bigEndian ? (data[i] << 8) | data[i + 1] : (data[i + 1] << 8) | data[i];
+            if (code == 0)
+                break;
+
+            // Суррогатная пара.
+            if (code >= 0xD800 && code < 0xDC00 && i + 3 < size) {
+                std::uint32_t low = bigEndian ? (data[i + 2] << 8) | data[i + 3] : (data[i + 3] << 8) | data[i + 2];
+                if (low >= 0xDC00 && low < 0xE000) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    i += 2;
+                }
+            }
+            appendUtf8(result, code);
+        }
+        return result;
+    }
+
+    unsigned int parseTrackNumber(std::string_view text) {
+        // Номер трека может быть записан как "3/12".
+        unsigned int number = 0;
+        for (char c : text) {
+            if (c < '0' || c > '9')
+                break;
+            number = number * 10 + static_cast<unsigned int>(c - '0');
+        }
+        return number;
+    }
+
+    // Теги читаются по порядку, и первое найденное значение поля не перезаписывается.
+    void setField(std::string& field, std::string value) {
+        if (field.empty())
+            field = std::move(value);
+    }
+
+    bool equalsIgnoreCase(std::string_view left, std::string_view right) {
+        if (left.size() != right.size())
+            return false;
+        for (std::size_t i = 0; i < left.size(); ++i) {
+            if (std::toupper(static_cast<unsigned char>(left[i])) != std::toupper(static_cast<unsigned char>(right[i])))
+                return false;
+        }
+        return true;
+    }
+
+    // Убирает из данных ID3v2 байты 0x00, вставленные после 0xFF (десинхронизация).
+    std::string removeUnsynchronisation(const unsigned char* data, std::size_t size) {
+        std::string result;
+        result.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            result += static_cast<char>(data[i]);
+            if (data[i] == 0xFF && i + 1 < size && data[i + 1] == 0x00)
+                ++i;
+        }
+        return result;
+    }
+
+    // Текстовый кадр ID3v2: байт кодировки и строка.
+    std::string decodeId3Text(const unsigned char* data, std::size_t size) {
+        if (size == 0)
+            return std::string();
+
+        unsigned char encoding = data[0];
+        ++data;
+        --size;
+
+        switch (encoding) {
+        case 1:
+            // UTF-16 с меткой порядка байтов.
+            if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF)
+                return utf16ToUtf8(data + 2, size - 2, true);
+            if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+                return utf16ToUtf8(data + 2, size - 2, false);
+            return utf16ToUtf8(data, size, false);
+        case 2:
+            return utf16ToUtf8(data, size, true);
+        case 3:
+            return std::string(trimText(std::string_view(reinterpret_cast<const char*>(data), size)));
+        default:
+            return singleByteToUtf8(std::string_view(reinterpret_cast<const char*>(data), size));
+        }
+    }
+
+    // Место сжатой картинки в файле.
+    struct PictureLocation {
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+        unsigned int  type = 0;   // 3 — передняя обложка
+    };
+
+    // Предпочитаем переднюю обложку, иначе берем первую картинку.
+    void setPicture(PictureLocation& picture, std::uint64_t offset, std::uint64_t size, unsigned int type) {
+        if (size > 0 && (picture.size == 0 || (type == 3 && picture.type != 3))) {
+            picture.offset = offset;
+            picture.size = size;
+            picture.type = type;
+        }
+    }
+
+    // Кадр APIC (PIC в 2.2): кодировка, формат, тип картинки, описание и сами данные.
+    void locateId3Picture(const unsigned char* data, std::size_t size, unsigned int version, std::uint64_t fileOffset, PictureLocation& picture) {
+        if (size < 4)
+            return;
+
+        unsigned char encoding = data[0];
+        std::size_t position = 1;
+        if (version == 2) {
+            position += 3;  // "JPG" или "PNG"
+        }
+        else {
+            while (position < size && data[position] != 0)
+                ++position;
+            ++position;
+        }
+        if (position >= size)
+            return;
+        unsigned int type = data[position++];
+
+        // Описание заканчивается нулем, в UTF-16 — двумя.
+        if (encoding == 1 || encoding == 2) {
+            while (position + 1 < size && (data[position] != 0 || data[position + 1] != 0))
+                position += 2;
+            position += 2;
+        }
+        else {
+            while (position < size && data[position] != 0)
+                ++position;
+            ++position;
+        }
+        if (position < size)
+            setPicture(picture, fileOffset + position, size - position, type);
+    }
+
+    // Разбирает тег ID3v2 по смещению offset. Возвращает его размер вместе с заголовком (0, если тега нет).
+    // Значение кадра TLEN (длительность в мс) возвращается отдельно: ему верят, только если нет заголовка Xing.
+    // Если передан picture, запоминается место обложки (данные картинки не читаются).
+    std::uint64_t readId3v2(FileWindow& window, std::uint64_t offset, TrackInfo& info, std::uint32_t& length, PictureLocation* picture) {
+        const unsigned char* header = window.map(offset, 10);
+        if (!header || std::memcmp(header, "ID3", 3) != 0 || header[3] < 2 || header[3] > 4 ||
+            ((header[6] | header[7] | header[8] | header[9]) & 0x80) != 0)
+            return 0;
+
+        unsigned int version = header[3];
+        unsigned char flags = header[5];
+        std::size_t tagSize = readSyncSafe32(header + 6);
+        std::uint64_t total = 10 + tagSize + ((version == 4 && (flags & 0x10)) ? 10 : 0);
+
+        // В ID3v2.2 этот флаг означает сжатие тега, которое не стандартизовано.
+        if (tagSize == 0 || (version == 2 && (flags & 0x40)))
+            return total;
+
+        const unsigned char* tag = window.map(offset + 10, tagSize);
+        if (!tag)
+            return total;
+
+        // До версии 2.4 десинхронизация применяется ко всему тегу — только тогда тег копируется.
+        std::string resynchronised;
+        if (version < 4 && (flags & 0x80)) {
+            resynchronised = removeUnsynchronisation(tag, tagSize);
+            tag = reinterpret_cast<const unsigned char*>(resynchronised.data());
+            tagSize = resynchronised.size();
+        }
+
+        std::size_t position = 0;
+        if ((flags & 0x40) && tagSize >= 4)
+            position = version == 3 ? 4 + readBigEndian32(tag) : readSyncSafe32(tag);
+
+        std::size_t frameHeaderSize = version == 2 ? 6 : 10;
+        while (position + frameHeaderSize <= tagSize) {
+            const unsigned char* frame = tag + position;
+            if (frame[0] == 0)
+                break;  // дальше только заполнение
+
+            std::string_view id(reinterpret_cast<const char*>(frame), version == 2 ? 3 : 4);
+            std::size_t frameSize;
+            unsigned int frameFlags = 0;
+            if (version == 2) {
+                frameSize = (frame[3] << 16) | (frame[4] << 8) | frame[5];
+            }
+            else {
+                frameSize = version == 4 ? readSyncSafe32(frame + 4) : readBigEndian32(frame + 4);
+                frameFlags = (frame[8] << 8) | frame[9];
+            }
+
+            position += frameHeaderSize;
+            if (frameSize > tagSize - position)
+                break;
+            const unsigned char* payload = tag + position;
+            position += frameSize;
+
+            std::string* field = nullptr;
+            bool isTrack = id == "TRCK" || id == "TRK";
+            bool isLength = id == "TLEN" || id == "TLE";
+            if (id == "TIT2" || id == "TT2")
+                field = &info.title;
+            else if (id == "TPE1" || id == "TP1")
+                field = &info.artist;
+            else if (id == "TALB" || id == "TAL")
+                field = &info.album;
+            else if (id == "APIC" || id == "PIC") {
+                // Картинку можно отдать декодеру прямо из файла, только если она не преобразована.
+                bool isStored = resynchronised.empty() && !(version == 3 && (frameFlags & 0x00C0)) &&
+                    !(version == 4 && ((frameFlags & 0x000F) || (flags & 0x80)));
+                if (picture && isStored)
+                    locateId3Picture(payload, frameSize, version, offset + 10 + static_cast<std::uint64_t>(payload - tag), *picture);
+                continue;
+            }
+            else if (!isTrack && !isLength)
+                continue;
+
+            // Сжатые и зашифрованные кадры пропускаем.
+            if ((version == 3 && (frameFlags & 0x00C0)) || (version == 4 && (frameFlags & 0x000C)))
+                continue;
+
+            // В 2.4 кадр может начинаться с исходной длины и быть десинхронизирован отдельно.
+            if (version == 4 && (frameFlags & 0x0001)) {
+                if (frameSize < 4)
+                    continue;
+                payload += 4;
+                frameSize -= 4;
+            }
+            std::string frameData;
+            if (version == 4 && ((frameFlags & 0x0002) || (flags & 0x80))) {
+                frameData = removeUnsynchronisation(payload, frameSize);
+                payload = reinterpret_cast<const unsigned char*>(frameData.data());
+                frameSize = frameData.size();
+            }
+
+            std::string text = decodeId3Text(payload, frameSize);
+            if (field)
+                setField(*field, std::move(text));
+            else if (isTrack && info.trackNumber == 0)
+                info.trackNumber = parseTrackNumber(text);
+            else if (isLength && length == 0)
+                length = parseTrackNumber(text);
+        }
+
+        return total;
+    }
+
+    // Тег ID3v1 в последних 128 байтах файла. Заполняет только поля, которых не было в ID3v2.
+    bool readId3v1(FileWindow& window, TrackInfo& info) {
+        if (window.getFileSize() < 128)
+            return false;
+
+        const unsigned char* tag = window.map(window.getFileSize() - 128, 128);
+        if (!tag || std::memcmp(tag, "TAG", 3) != 0)
+            return false;
+
+        const char* text = reinterpret_cast<const char*>(tag);
+        setField(info.title, singleByteToUtf8(std::string_view(text + 3, 30)));
+        setField(info.artist, singleByteToUtf8(std::string_view(text + 33, 30)));
+        setField(info.album, singleByteToUtf8(std::string_view(text + 63, 30)));
+
+        // ID3v1.1: номер трека в последнем байте комментария.
+        if (info.trackNumber == 0 && tag[125] == 0 && tag[126] != 0)
+            info.trackNumber = tag[126];
+        return true;
+    }
+
+    // Заголовок кадра MPEG audio.
+    struct MpegFrame {
+        unsigned int version;         // 1 — MPEG-1, 2 — MPEG-2, 3 — MPEG-2.5
+        unsigned int layer;
+        unsigned int bitrate;         // кбит/с
+        unsigned int sampleRate;
+        unsigned int samplesPerFrame;
+        std::size_t  size;
+        bool         mono;
+    };
+
+    bool parseMpegFrame(const unsigned char* data, MpegFrame& frame) {
+        static const unsigned short bitrates[5][15] = {
+            { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 }, // MPEG-1, Layer I
+            { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },    // MPEG-1, Layer II
+            { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },     // MPEG-1, Layer III
+            { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },    // MPEG-2, Layer I
+            { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }         // MPEG-2, Layer II и III
+        };
+        static const unsigned int sampleRates[3] = { 44100, 48000, 32000 };
+
+        if (data[0] != 0xFF || (data[1] & 0xE0) != 0xE0)
+            return false;
+
+        unsigned int versionBits = (data[1] >> 3) & 0x03;
+        unsigned int layerBits = (data[1] >> 1) & 0x03;
+        unsigned int bitrateIndex = data[2] >> 4;
+        unsigned int sampleRateIndex = (data[2] >> 2) & 0x03;
+        if (versionBits == 1 || layerBits == 0 || bitrateIndex == 0 || bitrateIndex == 15 || sampleRateIndex == 3)
+            return false;
+
+        frame.version = versionBits == 3 ? 1 : versionBits == 2 ? 2 : 3;
+        frame.layer = 4 - layerBits;
+        frame.mono = (data[3] >> 6) == 3;
+
+        int table = frame.version == 1 ? static_cast<int>(frame.layer) - 1 : (frame.layer == 1 ? 3 : 4);
+        frame.bitrate = bitrates[table][bitrateIndex];
+        frame.sampleRate = sampleRates[sampleRateIndex] >> (frame.version - 1);
+
+        unsigned int padding = (data[2] >> 1) & 0x01;
+        if (frame.layer == 1) {
+            frame.samplesPerFrame = 384;
+            frame.size = (12 * frame.bitrate * 1000 / frame.sampleRate + padding) * 4;
+        }
+        else {
+            frame.samplesPerFrame = (frame.layer == 3 && frame.version != 1) ? 576 : 1152;
+            frame.size = frame.samplesPerFrame / 8 * frame.bitrate * 1000 / frame.sampleRate + padding;
+        }
+        return true;
+    }
+
+    // Длительность MP3 по заголовку Xing/Info (с задержкой и заполнением LAME), VBRI или по битрейту.
+    bool readMpeg(FileWindow& window, std::uint64_t audioStart, std::uint32_t tagLength, TrackInfo& info) {
+        std::uint64_t audioEnd = window.getFileSize();
+        if (readId3v1(window, info))
+            audioEnd -= 128;
+        if (audioStart >= audioEnd)
+            return audioStart > 0;
+
+        std::size_t searchSize = static_cast<std::size_t>(std::min<std::uint64_t>(SyncSearchSize, audioEnd - audioStart));
+        const unsigned char* data = window.map(audioStart, searchSize);
+        if (!data)
+            return audioStart > 0;
+
+        // Первый кадр: заголовок, за которым сразу идет еще один подходящий заголовок.
+        MpegFrame frame = {};
+        std::size_t position = 0;
+        bool found = false;
+        for (; position + 4 <= searchSize; ++position) {
+            if (!parseMpegFrame(data + position, frame))
+                continue;
+
+            MpegFrame next;
+            std::size_t nextPosition = position + frame.size;
+            if (nextPosition + 4 > searchSize ||
+                (parseMpegFrame(data + nextPosition, next) && next.version == frame.version && next.layer == frame.layer && next.sampleRate == frame.sampleRate)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return audioStart > 0;
+
+        const unsigned char* end = data + searchSize;
+        const unsigned char* header = data + position;
+
+        // Заголовок Xing/Info лежит в первом кадре сразу после побочной информации.
+        std::size_t sideInfoSize = frame.version == 1 ? (frame.mono ? 17 : 32) : (frame.mono ? 9 : 17);
+        const unsigned char* xing = header + 4 + sideInfoSize;
+        const unsigned char* vbri = header + 4 + 32;
+        std::uint64_t samples = 0;
+
+        if (xing + 8 <= end && (std::memcmp(xing, "Xing", 4) == 0 || std::memcmp(xing, "Info", 4) == 0)) {
+            std::uint32_t flags = readBigEndian32(xing + 4);
+            const unsigned char* field = xing + 8;
+            if ((flags & 0x01) && field + 4 <= end) {
+                samples = static_cast<std::uint64_t>(readBigEndian32(field)) * frame.samplesPerFrame;
+                field += 4;
+            }
+            field += ((flags & 0x02) ? 4 : 0) + ((flags & 0x04) ? 100 : 0) + ((flags & 0x08) ? 4 : 0);
+
+            // Расширение LAME: задержка кодера и заполнение в конце, 12 бит каждое.
+            if (samples > 0 && field + 24 <= end &&
+                (std::memcmp(field, "LAME", 4) == 0 || std::memcmp(field, "Lavc", 4) == 0 || std::memcmp(field, "Lavf", 4) == 0)) {
+                std::uint64_t delay = (field[21] << 4) | (field[22] >> 4);
+                std::uint64_t padding = ((field[22] & 0x0F) << 8) | field[23];
+                if (delay + padding < samples)
+                    samples -= delay + padding;
+            }
+        }
+        else if (vbri + 18 <= end && std::memcmp(vbri, "VBRI", 4) == 0) {
+            samples = static_cast<std::uint64_t>(readBigEndian32(vbri + 14)) * frame.samplesPerFrame;
+        }
+
+        if (samples > 0)
+            info.duration = toMilliseconds(samples, frame.sampleRate);
+        else if (tagLength > 0)
+            info.duration = tagLength;
+        else
+            info.duration = static_cast<std::uint32_t>((audioEnd - audioStart - position) * 8 / frame.bitrate);
+        return true;
+    }
+
+    // Последовательное чтение из непрерывного участка памяти (блок VORBIS_COMMENT во FLAC).
+    class MemoryReader {
+    public:
+        MemoryReader(const unsigned char* data, std::size_t size)
+            : m_data(data), m_size(size) {
+        }
+
+        bool read(unsigned char* buffer, std::size_t size) {
+            if (size > m_size)
+                return false;
+            std::memcpy(buffer, m_data, size);
+            return skip(size);
+        }
+
+        bool skip(std::uint64_t size) {
+            if (size > m_size)
+                return false;
+            m_data += size;
+            m_size -= static_cast<std::size_t>(size);
+            return true;
+        }
+
+        bool view(std::size_t size, std::string_view& result, std::string&) {
+            if (size > m_size)
+                return false;
+            result = std::string_view(reinterpret_cast<const char*>(m_data), size);
+            return skip(size);
+        }
+
+    private:
+        const unsigned char* m_data;
+        std::size_t          m_size;
+    };
+
+    // Последовательное чтение пакета Ogg, который может занимать несколько страниц.
+    // Данные читаются прямо из отображения; копия делается, только если поле пересекает границу страниц.
+    class OggPacketReader {
+    public:
+        explicit OggPacketReader(FileWindow& window)
+            : m_window(window), m_nextPage(0), m_position(0), m_remaining(0),
+              m_segment(0), m_segmentCount(0), m_isComplete(true), m_isStarted(false) {
+        }
+
+        // Переходит к началу следующего пакета, пропуская остаток текущего.
+        bool nextPacket() {
+            if (m_isStarted) {
+                while (!m_isComplete) {
+                    if (!loadPage() || !loadChunk())
+                        return false;
+                }
+                m_position += m_remaining;
+                m_remaining = 0;
+            }
+            m_isStarted = true;
+
+            while (m_segment >= m_segmentCount) {
+                if (!loadPage())
+                    return false;
+            }
+            return loadChunk();
+        }
+
+        bool read(unsigned char* buffer, std::size_t size) {
+            while (size > 0) {
+                if (!prepare())
+                    return false;
+                std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(size, m_remaining));
+                const unsigned char* data = m_window.map(m_position, count);
+                if (!data)
+                    return false;
+                std::memcpy(buffer, data, count);
+                advance(count);
+                buffer += count;
+                size -= count;
+            }
+            return true;
+        }
+
+        bool skip(std::uint64_t size) {
+            while (size > 0) {
+                if (!prepare())
+                    return false;
+                std::uint64_t count = std::min(size, m_remaining);
+                advance(count);
+                size -= count;
+            }
+            return true;
+        }
+
+        bool view(std::size_t size, std::string_view& result, std::string& scratch) {
+            if (size == 0) {
+                result = std::string_view();
+                return true;
+            }
+            if (!prepare())
+                return false;
+
+            if (size <= m_remaining) {
+                const unsigned char* data = m_window.map(m_position, size);
+                if (!data)
+                    return false;
+                result = std::string_view(reinterpret_cast<const char*>(data), size);
+                advance(size);
+                return true;
+            }
+
+            scratch.resize(size);
+            if (!read(reinterpret_cast<unsigned char*>(&scratch[0]), size))
+                return false;
+            result = scratch;
+            return true;
+        }
+
+    private:
+        // Читает заголовок следующей страницы и таблицу длин ее сегментов.
+        bool loadPage() {
+            const unsigned char* header = m_window.map(m_nextPage, 27);
+            if (!header || std::memcmp(header, "OggS", 4) != 0)
+                return false;
+
+            m_segmentCount = header[26];
+            m_segment = 0;
+            std::uint64_t bodySize = 0;
+            if (m_segmentCount > 0) {
+                const unsigned char* lacing = m_window.map(m_nextPage + 27, m_segmentCount);
+                if (!lacing)
+                    return false;
+                std::memcpy(m_lacing, lacing, m_segmentCount);
+                for (unsigned int i = 0; i < m_segmentCount; ++i)
+                    bodySize += m_lacing[i];
+            }
+
+            m_position = m_nextPage + 27 + m_segmentCount;
+            m_nextPage = m_position + bodySize;
+            return true;
+        }
+
+        // Собирает сегменты текущего пакета, идущие подряд на этой странице.
+        bool loadChunk() {
+            if (m_segment >= m_segmentCount)
+                return false;
+
+            m_remaining = 0;
+            m_isComplete = false;
+            while (m_segment < m_segmentCount) {
+                unsigned char length = m_lacing[m_segment++];
+                m_remaining += length;
+                if (length < 255) {
+                    m_isComplete = true;
+                    break;
+                }
+            }
+            return true;
+        }
+
+        // Гарантирует, что в текущей порции есть данные; пакет продолжается на следующей странице.
+        bool prepare() {
+            while (m_remaining == 0) {
+                if (m_isComplete || !loadPage() || !loadChunk())
+                    return false;
+            }
+            return true;
+        }
+
+        void advance(std::uint64_t count) {
+            m_position += count;
+            m_remaining -= count;
+        }
+
+        FileWindow&   m_window;
+        std::uint64_t m_nextPage;     // смещение следующей страницы
+        std::uint64_t m_position;     // смещение следующего байта пакета
+        std::uint64_t m_remaining;    // байт пакета на текущей странице начиная с m_position
+        unsigned char m_lacing[255];
+        unsigned int  m_segment;
+        unsigned int  m_segmentCount;
+        bool          m_isComplete;   // текущая порция завершает пакет
+        bool          m_isStarted;
+    };
+
+    // Комментарии Vorbis (FLAC и Ogg): строка производителя и поля "КЛЮЧ=значение" в UTF-8.
+    // Большие поля, например обложки, пропускаются без чтения.
+    template <typename Reader>
+    void readVorbisComments(Reader& reader, TrackInfo& info) {
+        unsigned char length[4];
+        if (!reader.read(length, 4) || !reader.skip(readLittleEndian32(length)) || !reader.read(length, 4))
+            return;
+
+        std::uint32_t count = readLittleEndian32(length);
+        std::string scratch;
+        for (std::uint32_t i = 0; i < count; ++i) {
+            if (!reader.read(length, 4))
+                return;
+            std::uint32_t size = readLittleEndian32(length);
+
+            // Сначала узнаем ключ по началу поля.
+            std::string_view start;
+            if (!reader.view(std::min<std::size_t>(size, CommentKeySize), start, scratch))
+                return;
+            std::string_view key = start.substr(0, start.find('='));
+
+            std::string* field = nullptr;
+            bool isTrack = equalsIgnoreCase(key, "TRACKNUMBER");
+            if (equalsIgnoreCase(key, "TITLE"))
+                field = &info.title;
+            else if (equalsIgnoreCase(key, "ARTIST"))
+                field = &info.artist;
+            else if (equalsIgnoreCase(key, "ALBUM"))
+                field = &info.album;
+
+            std::size_t rest = size - start.size();
+            if ((!field && !isTrack) || key.size() == start.size()) {
+                if (!reader.skip(rest))
+                    return;
+                continue;
+            }
+
+            std::string value(start.substr(key.size() + 1));
+            std::string_view tail;
+            if (!reader.view(rest, tail, scratch))
+                return;
+            value.append(tail.data(), tail.size());
+
+            if (field)
+                setField(*field, std::move(value));
+            else if (info.trackNumber == 0)
+                info.trackNumber = parseTrackNumber(value);
+        }
+    }
+
+    // Блок PICTURE: тип, MIME-тип, описание, размеры и сами данные. Отображаются только поля длин.
+    void locateFlacPicture(FileWindow& window, std::uint64_t offset, std::uint64_t blockSize, PictureLocation& picture) {
+        std::uint64_t end = offset + blockSize;
+        const unsigned char* header = window.map(offset, 8);
+        if (!header)
+            return;
+        unsigned int type = readBigEndian32(header);
+
+        std::uint64_t position = offset + 8 + readBigEndian32(header + 4);
+        const unsigned char* description = position + 4 <= end ? window.map(position, 4) : nullptr;
+        if (!description)
+            return;
+
+        position += 4 + readBigEndian32(description) + 16;
+        const unsigned char* data = position + 4 <= end ? window.map(position, 4) : nullptr;
+        if (!data)
+            return;
+
+        std::uint64_t size = readBigEndian32(data);
+        if (position + 4 + size <= end)
+            setPicture(picture, position + 4, size, type);
+    }
+
+    // FLAC: блоки метаданных после метки "fLaC". Блоки-обложки пропускаются без отображения.
+    bool readFlac(FileWindow& window, std::uint64_t offset, TrackInfo& info, PictureLocation* picture) {
+        std::uint64_t position = offset + 4;
+        while (true) {
+            const unsigned char* header = window.map(position, 4);
+            if (!header)
+                break;
+
+            bool isLast = (header[0] & 0x80) != 0;
+            unsigned int type = header[0] & 0x7F;
+            std::size_t size = (header[1] << 16) | (header[2] << 8) | header[3];
+            position += 4;
+
+            if (type == 0 && size >= 18) {
+                // STREAMINFO: частота (20 бит) и число сэмплов (36 бит).
+                const unsigned char* streamInfo = window.map(position, 18);
+                if (streamInfo) {
+                    std::uint32_t sampleRate = (streamInfo[10] << 12) | (streamInfo[11] << 4) | (streamInfo[12] >> 4);
+                    std::uint64_t samples = (static_cast<std::uint64_t>(streamInfo[13] & 0x0F) << 32) | readBigEndian32(streamInfo + 14);
+                    info.duration = toMilliseconds(samples, sampleRate);
+                }
+            }
+            else if (type == 4 && size > 0) {
+                const unsigned char* comments = window.map(position, size);
+                if (comments) {
+                    MemoryReader reader(comments, size);
+                    readVorbisComments(reader, info);
+                }
+            }
+            else if (type == 6 && picture) {
+                locateFlacPicture(window, position, size, *picture);
+            }
+            else if (type == 127) {
+                break;
+            }
+
+            position += size;
+            if (isLast)
+                break;
+        }
+        return true;
+    }
+
+    // Ogg Vorbis: заголовок идентификации, комментарии и позиция последней страницы.
+    bool readOgg(FileWindow& window, TrackInfo& info) {
+        OggPacketReader reader(window);
+
+        unsigned char identification[16];
+        if (!reader.nextPacket() || !reader.read(identification, sizeof(identification)) ||
+            identification[0] != 1 || std::memcmp(identification + 1, "vorbis", 6) != 0)
+            return false;
+        std::uint32_t sampleRate = readLittleEndian32(identification + 12);
+
+        unsigned char header[7];
+        if (reader.nextPacket() && reader.read(header, sizeof(header)) && header[0] == 3 && std::memcmp(header + 1, "vorbis", 6) == 0)
+            readVorbisComments(reader, info);
+
+        // Длительность — позиция последней страницы в сэмплах. Ищем ее с конца файла.
+        std::size_t tailSize = static_cast<std::size_t>(std::min<std::uint64_t>(WindowSize, window.getFileSize()));
+        const unsigned char* tail = window.map(window.getFileSize() - tailSize, tailSize);
+        for (std::size_t position = tail && tailSize >= 27 ? tailSize - 27 + 1 : 0; position-- > 0;) {
+            if (std::memcmp(tail + position, "OggS", 4) != 0 || tail[position + 4] != 0)
+                continue;
+            std::uint64_t granule = readLittleEndian64(tail + position + 6);
+            if (granule != ~static_cast<std::uint64_t>(0)) {
+                info.duration = toMilliseconds(granule, sampleRate);
+                break;
+            }
+        }
+        return true;
+    }
+
+    // WAV: формат и размер данных из RIFF, теги из LIST/INFO.
+    bool readWave(FileWindow& window, TrackInfo& info) {
+        const unsigned char* riff = window.map(0, 12);
+        if (!riff || std::memcmp(riff + 8, "WAVE", 4) != 0)
+            return false;
+
+        std::uint32_t byteRate = 0;
+        std::uint64_t dataSize = 0;
+        std::uint64_t position = 12;
+        while (position + 8 <= window.getFileSize()) {
+            const unsigned char* chunk = window.map(position, 8);
+            if (!chunk)
+                break;
+
+            char id[4];
+            std::memcpy(id, chunk, 4);
+            std::uint32_t size = readLittleEndian32(chunk + 4);
+            std::uint64_t body = position + 8;
+
+            if (std::memcmp(id, "fmt ", 4) == 0 && size >= 16) {
+                const unsigned char* format = window.map(body, 16);
+                if (format)
+                    byteRate = readLittleEndian32(format + 8);
+            }
+            else if (std::memcmp(id, "data", 4) == 0) {
+                dataSize = std::min<std::uint64_t>(size, window.getFileSize() - body);
+            }
+            else if (std::memcmp(id, "LIST", 4) == 0 && size >= 4) {
+                const unsigned char* list = window.map(body, size);
+                if (list && std::memcmp(list, "INFO", 4) == 0) {
+                    for (std::size_t item = 4; item + 8 <= size;) {
+                        std::size_t itemSize = readLittleEndian32(list + item + 4);
+                        if (itemSize > size - item - 8)
+                            break;
+
+                        std::string_view itemId(reinterpret_cast<const char*>(list + item), 4);
+                        std::string_view text(reinterpret_cast<const char*>(list + item + 8), itemSize);
+                        if (itemId == "INAM")
+                            setField(info.title, singleByteToUtf8(text));
+                        else if (itemId == "IART")
+                            setField(info.artist, singleByteToUtf8(text));
+                        else if (itemId == "IPRD")
+                            setField(info.album, singleByteToUtf8(text));
+                        else if ((itemId == "ITRK" || itemId == "IPRT") && info.trackNumber == 0)
+                            info.trackNumber = parseTrackNumber(text);
+
+                        item += 8 + itemSize + (itemSize & 1);
+                    }
+                }
+            }
+
+            position = body + size + (size & 1);
+        }
+
+        if (byteRate > 0)
+            info.duration = static_cast<std::uint32_t>(dataSize * 1000 / byteRate);
+        return true;
+    }
+
+    // Конец блоков метаданных FLAC, то есть начало первого кадра.
+    std::uint64_t findFlacFrames(FileWindow& window, std::uint64_t offset) {
+        std::uint64_t position = offset + 4;
+        while (true) {
+            const unsigned char* header = window.map(position, 4);
+            if (!header)
+                return 0;
+
+            bool isLast = (header[0] & 0x80) != 0;
+            std::size_t size = (header[1] << 16) | (header[2] << 8) | header[3];
+            position += 4 + size;
+            if (isLast)
+                return position;
+        }
+    }
+
+    // Первая страница Ogg после трех заголовков Vorbis. По спецификации первый звуковой пакет
+    // начинается с новой страницы, поэтому все последующие страницы — звук.
+    std::uint64_t findOggAudio(FileWindow& window) {
+        std::uint64_t position = 0;
+        unsigned int packets = 0;
+        while (packets < 3) {
+            const unsigned char* page = window.map(position, 27);
+            if (!page || std::memcmp(page, "OggS", 4) != 0)
+                return 0;
+
+            unsigned int segmentCount = page[26];
+            const unsigned char* segments = window.map(position + 27, segmentCount);
+            if (segmentCount > 0 && !segments)
+                return 0;
+
+            // Пакет заканчивается на сегменте короче 255 байт.
+            std::uint64_t bodySize = 0;
+            for (unsigned int i = 0; i < segmentCount; ++i) {
+                bodySize += segments[i];
+                if (segments[i] < 255)
+                    ++packets;
+            }
+            position += 27 + segmentCount + bodySize;
+        }
+        return position;
+    }
+
+    // Тело блока data в WAV.
+    bool findWaveData(FileWindow& window, std::uint64_t& offset, std::uint64_t& size) {
+        std::uint64_t position = 12;
+        while (position + 8 <= window.getFileSize()) {
+            const unsigned char* chunk = window.map(position, 8);
+            if (!chunk)
+                return false;
+
+            std::uint32_t chunkSize = readLittleEndian32(chunk + 4);
+            if (std::memcmp(chunk, "data", 4) == 0) {
+                offset = position + 8;
+                size = std::min<std::uint64_t>(chunkSize, window.getFileSize() - offset);
+                return true;
+            }
+            position += 8 + chunkSize + (chunkSize & 1);
+        }
+        return false;
+    }
+}
+
+bool TagReader::read(const std::string& path, TrackInfo& info) {
+    info = TrackInfo();
+
+    FileWindow window(path);
+    if (!window.open())
+        return false;
+
+    // ID3v2 встречается не только в MP3, но и перед потоком FLAC.
+    std::uint32_t tagLength = 0;
+    std::uint64_t audioStart = readId3v2(window, 0, info, tagLength, nullptr);
+
+    const unsigned char* magic = window.map(audioStart, 4);
+    if (magic && std::memcmp(magic, "fLaC", 4) == 0)
+        return readFlac(window, audioStart, info, nullptr);
+    if (magic && std::memcmp(magic, "OggS", 4) == 0)
+        return readOgg(window, info);
+    if (magic && std::memcmp(magic, "RIFF", 4) == 0)
+        return readWave(window, info);
+    return readMpeg(window, audioStart, tagLength, info);
+}
+
+bool TagReader::findPicture(const std::string& path, std::uint64_t& offset, std::uint64_t& size) {
+    FileWindow window(path);
+    if (!window.open())
+        return false;
+
+    TrackInfo info;
+    PictureLocation picture;
+    std::uint32_t tagLength = 0;
+    std::uint64_t audioStart = readId3v2(window, 0, info, tagLength, &picture);
+
+    const unsigned char* magic = window.map(audioStart, 4);
+    if (magic && std::memcmp(magic, "fLaC", 4) == 0)
+        readFlac(window, audioStart, info, &picture);
+
+    if (picture.size == 0)
+        return false;
+    offset = picture.offset;
+    size = picture.size;
+    return true;
+}
+
+bool TagReader::findAudio(const std::string& path, std::uint64_t& offset, std::uint64_t& size) {
+    FileWindow window(path);
+    if (!window.open())
+        return false;
+
+    TrackInfo info;
+    std::uint32_t tagLength = 0;
+    std::uint64_t audioStart = readId3v2(window, 0, info, tagLength, nullptr);
+    std::uint64_t audioEnd = window.getFileSize();
+
+    const unsigned char* magic = window.map(audioStart, 4);
+    if (magic && std::memcmp(magic, "fLaC", 4) == 0) {
+        audioStart = findFlacFrames(window, audioStart);
+        if (audioStart == 0)
+            return false;
+    }
+    else if (magic && std::memcmp(magic, "OggS", 4) == 0) {
+        audioStart = findOggAudio(window);
+        if (audioStart == 0)
+            return false;
+    }
+    else if (magic && std::memcmp(magic, "RIFF", 4) == 0) {
+        return findWaveData(window, offset, size);
+    }
+    else {
+        // MP3: в конце файла может быть ID3v1.
+        const unsigned char* tag = audioEnd >= 128 ? window.map(audioEnd - 128, 3) : nullptr;
+        if (tag && std::memcmp(tag, "TAG", 3) == 0)
+            audioEnd -= 128;
+    }
+
+    if (audioStart >= audioEnd)
+        return false;
+    offset = audioStart;
+    size = audioEnd - audioStart;
+    return true;
+}
@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Метаданные трека. Строки в UTF-8, пустая строка — тег не найден.
+struct TrackInfo {
+    std::string   title;
+    std::string   artist;
+    std::string   album;
+    unsigned int  trackNumber = 0; // 0 — номер неизвестен
+    std::uint32_t duration = 0;    // длительность в миллисекундах, 0 — неизвестна
+    std::uint64_t id = 0;          // постоянный идентификатор по содержимому (см. TrackId), 0 — неизвестен
+};
+
+// Чтение тегов и длительности без декодирования звука.
+// В память отображаются только участки файла с тегами и заголовками (начало файла, конец файла,
+// отдельные блоки FLAC и страницы Ogg), а поля разбираются прямо в отображении.
+// Копируются только итоговые строки TrackInfo.
+//
+// Поддерживаются ID3v2.2–2.4 и ID3v1 с заголовками Xing/Info/LAME и VBRI (MP3),
+// блоки STREAMINFO и VORBIS_COMMENT (FLAC), комментарии Ogg Vorbis и LIST/INFO (WAV).
+// Методы не используют общего состояния и вызываются из любых потоков одновременно.
+class TagReader {
+public:
+    // Читает теги файла. Возвращает false, если файл не открылся или формат не распознан.
+    static bool read(const std::string& path, TrackInfo& info);
+
+    // Находит встроенную обложку (ID3v2 APIC или блок FLAC PICTURE, передняя обложка в приоритете).
+    // Возвращает смещение и размер сжатого изображения в файле, сама картинка не читается.
+    static bool findPicture(const std::string& path, std::uint64_t& offset, std::uint64_t& size);
+
+    // Находит сжатые звуковые данные без тегов: MP3 между ID3v2 и ID3v1, кадры FLAC после блоков
+    // метаданных, страницы Ogg после заголовков Vorbis, тело блока data в WAV.
+    static bool findAudio(const std::string& path, std::uint64_t& offset, std::uint64_t& size);
+};
@@ -0,0 +1,199 @@
+﻿#include "ThumbnailCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+#include "MappedFile.h"
+
+struct ThumbnailCache::Header {
+    char          magic[4];       // "WPTH"
+    std::uint32_t version;
+    std::int64_t  sourceTime;
+    std::uint64_t sourceOffset;
+    std::uint64_t sourceSize;
+    std::uint64_t hash;           // хеш исходной сжатой картинки
+    std::uint32_t thumbnailSize;  // размер эскизов, для которого он построен
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t reserved;
+};
+
+namespace {
+    const char ThumbnailMagic[4] = { 'W', 'P', 'T', 'H' };
+    const std::uint32_t ThumbnailVersion = 1;
+}
+
+ThumbnailCache::ThumbnailCache(const std::string& directory, unsigned int size, std::uint64_t diskBudget)
+    : m_directory(directory), m_size(size), m_diskBudget(diskBudget) {
+}
+
+bool ThumbnailCache::load(const std::string& source, std::uint64_t offset, std::uint64_t size, std::int64_t time, std::uint64_t& hash, sf::Image& image) {
+    std::string path = getPath(source, offset);
+    MappedFile file;
+    if (!file.open(path) || file.getSize() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, file.getData(), sizeof(header));
+    if (std::memcmp(header.magic, ThumbnailMagic, sizeof(ThumbnailMagic)) != 0 || header.version != ThumbnailVersion ||
+        header.sourceTime != time || header.sourceOffset != offset || header.sourceSize != size || header.thumbnailSize != m_size ||
+        header.width == 0 || header.height == 0 || header.width > m_size || header.height > m_size ||
+        file.getSize() != sizeof(Header) + static_cast<std::size_t>(header.width) * header.height * 4)
+        return false;
+
+    image.create(header.width, header.height, file.getData() + sizeof(Header));
+    hash = header.hash;
+
+    // Время изменения эскиза служит временем последнего использования для prune().
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    return true;
+}
+
+sf::Image ThumbnailCache::save(const std::string& source, std::uint64_t offset, std::uint64_t size, std::int64_t time, std::uint64_t hash, const sf::Image& image) {
+    sf::Image thumbnail = scale(image, m_size);
+
+    Header header;
+    std::memcpy(header.magic, ThumbnailMagic, sizeof(ThumbnailMagic));
+    header.version = ThumbnailVersion;
+    header.sourceTime = time;
+    header.sourceOffset = offset;
+    header.sourceSize = size;
+    header.hash = hash;
+    header.thumbnailSize = m_size;
+    header.width = thumbnail.getSize().x;
+    header.height = thumbnail.getSize().y;
+    header.reserved = 0;
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+
+    // Пишем во временный файл и переименовываем, чтобы не оставить половину эскиза при сбое.
+    std::string path = getPath(source, offset);
+    std::ofstream file(path + ".tmp", std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return thumbnail;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(thumbnail.getPixelsPtr()), static_cast<std::streamsize>(header.width) * header.height * 4);
+    file.close();
+
+    if (!file.fail())
+        std::filesystem::rename(path + ".tmp", path, error);
+    else
+        std::filesystem::remove(path + ".tmp", error);
+    return thumbnail;
+}
+
+void ThumbnailCache::prune() {
+    struct Thumbnail {
+        std::filesystem::file_time_type time;
+        std::uint64_t                   size;
+        std::filesystem::path           path;
+    };
+
+    std::vector<Thumbnail> thumbnails;
+    std::uint64_t total = 0;
+    std::error_code error;
+    std::filesystem::directory_iterator it(m_directory, error);
+    std::filesystem::directory_iterator end;
+    for (; !error && it != end; it.increment(error)) {
+        std::error_code entryError;
+        if (!it->is_regular_file(entryError))
+            continue;
+
+        Thumbnail thumbnail = { it->last_write_time(entryError), it->file_size(entryError), it->path() };
+        if (entryError)
+            continue;
+        total += thumbnail.size;
+        thumbnails.push_back(std::move(thumbnail));
+    }
+
+    if (total <= m_diskBudget)
+        return;
+
+    // Удаляем давно не использованные эскизы, пока каталог не уложится в предел.
+    std::sort(thumbnails.begin(), thumbnails.end(), [](const Thumbnail& left, const Thumbnail& right) {
+        return left.time < right.time;
+    });
+    for (const auto& thumbnail : thumbnails) {
+        if (total <= m_diskBudget)
+            break;
+        std::error_code removeError;
+        if (std::filesystem::remove(thumbnail.path, removeError))
+            total -= thumbnail.size;
+    }
+}
+
+sf::Image ThumbnailCache::scale(const sf::Image& image, unsigned int size) {
+    sf::Vector2u source = image.getSize();
+    unsigned int largest = std::max(source.x, source.y);
+    if (largest <= size || source.x == 0 || source.y == 0)
+        return image;
+
+    unsigned int width = std::max(1u, static_cast<unsigned int>(static_cast<std::uint64_t>(source.x) * size / largest));
+    unsigned int height = std::max(1u, static_cast<unsigned int>(static_cast<std::uint64_t>(source.y) * size / largest));
+
+    // Границы исходных столбцов для каждого столбца эскиза.
+    std::vector<unsigned int> columns(width + 1);
+    for (unsigned int x = 0; x <= width; ++x)
+        columns[x] = static_cast<unsigned int>(static_cast<std::uint64_t>(x) * source.x / width);
+
+    const sf::Uint8* pixels = image.getPixelsPtr();
+    std::vector<sf::Uint8> result(static_cast<std::size_t>(width) * height * 4);
+    std::vector<std::uint32_t> sums(static_cast<std::size_t>(width) * 4);
+
+    // Каждый пиксель эскиза — среднее прямоугольника исходных пикселей.
+    for (unsigned int y = 0; y < height; ++y) {
+        unsigned int top = static_cast<unsigned int>(static_cast<std::uint64_t>(y) * source.y / height);
+        unsigned int bottom = static_cast<unsigned int>(static_cast<std::uint64_t>(y + 1) * source.y / height);
+
+        std::fill(sums.begin(), sums.end(), 0);
+        for (unsigned int row = top; row < bottom; ++row) {
+            const sf::Uint8* line = pixels + static_cast<std::size_t>(row) * source.x * 4;
+            for (unsigned int x = 0; x < width; ++x) {
+                std::uint32_t* sum = &sums[x * 4];
+                for (unsigned int column = columns[x]; column < columns[x + 1]; ++column) {
+                    const sf::Uint8* pixel = line + column * 4;
+                    sum[0] += pixel[0];
+                    sum[1] += pixel[1];
+                    sum[2] += pixel[2];
+                    sum[3] += pixel[3];
+                }
+            }
+        }
+
+        sf::Uint8* output = &result[static_cast<std::size_t>(y) * width * 4];
+        for (unsigned int x = 0; x < width; ++x) {
+            std::uint32_t count = (columns[x + 1] - columns[x]) * (bottom - top);
+            for (unsigned int channel = 0; channel < 4; ++channel)
+                output[x * 4 + channel] = static_cast<sf::Uint8>((sums[x * 4 + channel] + count / 2) / count);
+        }
+    }
+
+    sf::Image thumbnail;
+    thumbnail.create(width, height, result.data());
+    return thumbnail;
+}
+
+std::string ThumbnailCache::getPath(const std::string& source, std::uint64_t offset) const {
+    // Имя файла — FNV-1a пути источника и смещения картинки в нем.
+    std::uint64_t hash = 14695981039346656037ull;
+    for (char c : source) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    for (int i = 0; i < 8; ++i) {
+        hash ^= (offset >> (i * 8)) & 0xFF;
+        hash *= 1099511628211ull;
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.thumb", static_cast<unsigned long long>(hash));
+    return (std::filesystem::path(m_directory) / name).string();
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <SFML/Graphics.hpp>
+
+// Дисковый кэш уменьшенных обложек.
+// Эскиз хранится как несжатые пиксели RGBA нужного интерфейсу размера, поэтому при попадании
+// обложка загружается одним чтением небольшого файла, без декодирования JPEG/PNG.
+//
+// Ключ — файл-источник и место картинки в нем, эскиз действителен, пока время изменения источника
+// не поменялось. Вместе с эскизом хранится хеш исходной картинки (см. CoverCache).
+// Объем каталога ограничен: при запуске (prune) удаляются давно не использованные эскизы.
+// Методы вызываются из одного фонового потока.
+class ThumbnailCache {
+public:
+    // size — наибольшая сторона эскиза, diskBudget — предельный объем каталога в байтах.
+    ThumbnailCache(const std::string& directory, unsigned int size, std::uint64_t diskBudget);
+
+    // Читает эскиз картинки, лежащей в source по смещению offset (size байт). Возвращает false,
+    // если эскиза нет или источник изменился (time — время изменения источника).
+    bool load(const std::string& source, std::uint64_t offset, std::uint64_t size, std::int64_t time, std::uint64_t& hash, sf::Image& image);
+
+    // Уменьшает картинку до размера эскиза (без увеличения) и сохраняет ее. Возвращает эскиз.
+    sf::Image save(const std::string& source, std::uint64_t offset, std::uint64_t size, std::int64_t time, std::uint64_t hash, const sf::Image& image);
+
+    // Удаляет самые старые эскизы сверх предельного объема.
+    void prune();
+
+    // Уменьшает картинку так, чтобы большая сторона не превышала size, усредняя пиксели.
+    static sf::Image scale(const sf::Image& image, unsigned int size);
+
+private:
+    struct Header;
+
+    std::string getPath(const std::string& source, std::uint64_t offset) const;
+
+    std::string   m_directory;
+    unsigned int  m_size;
+    std::uint64_t m_diskBudget;
+};
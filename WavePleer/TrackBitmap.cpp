@@ -0,0 +1,372 @@
+﻿#include "TrackBitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+    // Больше стольких элементов массив занимает больше места, чем битовая карта (8 КиБ).
+    const std::size_t ArrayLimit = 4096;
+    const std::size_t WordCount = 65536 / 64;
+
+    std::uint32_t countBits(std::uint64_t word) {
+#ifdef _MSC_VER
+        return static_cast<std::uint32_t>(__popcnt64(word));
+#else
+        return static_cast<std::uint32_t>(__builtin_popcountll(word));
+#endif
+    }
+
+    unsigned int findLowestBit(std::uint64_t word) {
+#ifdef _MSC_VER
+        unsigned long bit;
+        _BitScanForward64(&bit, word);
+        return bit;
+#else
+        return static_cast<unsigned int>(__builtin_ctzll(word));
+#endif
+    }
+
+    std::uint32_t countWords(const std::vector<std::uint64_t>& words) {
+        std::uint32_t count = 0;
+        for (std::uint64_t word : words)
+            count += countBits(word);
+        return count;
+    }
+
+    std::uint16_t getKey(std::uint32_t track) {
+        return static_cast<std::uint16_t>(track >> 16);
+    }
+
+    std::uint16_t getLow(std::uint32_t track) {
+        return static_cast<std::uint16_t>(track & 0xFFFF);
+    }
+}
+
+bool TrackBitmap::Container::isDense() const {
+    return !words.empty();
+}
+
+bool TrackBitmap::Container::contains(std::uint16_t value) const {
+    if (isDense())
+        return (words[value >> 6] >> (value & 63)) & 1;
+    return std::binary_search(values.begin(), values.end(), value);
+}
+
+TrackBitmap::TrackBitmap()
+    : m_size(0) {
+}
+
+bool TrackBitmap::add(std::uint32_t track) {
+    std::uint16_t key = getKey(track);
+    std::uint16_t low = getLow(track);
+
+    auto found = std::lower_bound(m_containers.begin(), m_containers.end(), key,
+        [](const Container& container, std::uint16_t key) { return container.key < key; });
+    if (found == m_containers.end() || found->key != key) {
+        Container container;
+        container.key = key;
+        container.cardinality = 0;
+        found = m_containers.insert(found, std::move(container));
+    }
+
+    Container& container = *found;
+    if (container.isDense()) {
+        std::uint64_t& word = container.words[low >> 6];
+        std::uint64_t bit = std::uint64_t(1) << (low & 63);
+        if (word & bit)
+            return false;
+        word |= bit;
+    }
+    else {
+        // Индексы обычно добавляются по возрастанию, поэтому вставка чаще всего идет в конец.
+        auto position = container.values.empty() || container.values.back() < low ? container.values.end() :
+            std::lower_bound(container.values.begin(), container.values.end(), low);
+        if (position != container.values.end() && *position == low)
+            return false;
+        container.values.insert(position, low);
+    }
+
+    ++container.cardinality;
+    ++m_size;
+    normalize(container);
+    return true;
+}
+
+bool TrackBitmap::remove(std::uint32_t track) {
+    std::uint16_t key = getKey(track);
+    std::uint16_t low = getLow(track);
+
+    auto found = std::lower_bound(m_containers.begin(), m_containers.end(), key,
+        [](const Container& container, std::uint16_t key) { return container.key < key; });
+    if (found == m_containers.end() || found->key != key)
+        return false;
+
+    Container& container = *found;
+    if (container.isDense()) {
+        std::uint64_t& word = container.words[low >> 6];
+        std::uint64_t bit = std::uint64_t(1) << (low & 63);
+        if (!(word & bit))
+            return false;
+        word &= ~bit;
+    }
+    else {
+        auto position = std::lower_bound(container.values.begin(), container.values.end(), low);
+        if (position == container.values.end() || *position != low)
+            return false;
+        container.values.erase(position);
+    }
+
+    --container.cardinality;
+    --m_size;
+    if (container.cardinality == 0)
+        m_containers.erase(found);
+    else
+        normalize(container);
+    return true;
+}
+
+bool TrackBitmap::contains(std::uint32_t track) const {
+    const Container* container = findContainer(getKey(track));
+    return container && container->contains(getLow(track));
+}
+
+std::size_t TrackBitmap::getSize() const {
+    return m_size;
+}
+
+bool TrackBitmap::isEmpty() const {
+    return m_size == 0;
+}
+
+void TrackBitmap::clear() {
+    m_containers.clear();
+    m_size = 0;
+}
+
+void TrackBitmap::getValues(std::vector<std::uint32_t>& values) const {
+    values.reserve(values.size() + m_size);
+    for (const auto& container : m_containers) {
+        std::uint32_t high = static_cast<std::uint32_t>(container.key) << 16;
+        if (container.isDense()) {
+            for (std::size_t i = 0; i < WordCount; ++i) {
+                for (std::uint64_t word = container.words[i]; word != 0; word &= word - 1)
+                    values.push_back(high | static_cast<std::uint32_t>(i * 64 + findLowestBit(word)));
+            }
+        }
+        else {
+            for (std::uint16_t value : container.values)
+                values.push_back(high | value);
+        }
+    }
+}
+
+TrackBitmap TrackBitmap::operator|(const TrackBitmap& other) const {
+    TrackBitmap result;
+    result.m_containers.reserve(m_containers.size() + other.m_containers.size());
+
+    auto left = m_containers.begin();
+    auto right = other.m_containers.begin();
+    while (left != m_containers.end() || right != other.m_containers.end()) {
+        if (right == other.m_containers.end() || (left != m_containers.end() && left->key < right->key))
+            result.m_containers.push_back(*left++);
+        else if (left == m_containers.end() || right->key < left->key)
+            result.m_containers.push_back(*right++);
+        else
+            result.m_containers.push_back(unite(*left++, *right++));
+        result.m_size += result.m_containers.back().cardinality;
+    }
+    return result;
+}
+
+TrackBitmap TrackBitmap::operator&(const TrackBitmap& other) const {
+    TrackBitmap result;
+
+    auto left = m_containers.begin();
+    auto right = other.m_containers.begin();
+    while (left != m_containers.end() && right != other.m_containers.end()) {
+        if (left->key < right->key) {
+            ++left;
+        }
+        else if (right->key < left->key) {
+            ++right;
+        }
+        else {
+            Container container = intersect(*left++, *right++);
+            if (container.cardinality > 0) {
+                result.m_size += container.cardinality;
+                result.m_containers.push_back(std::move(container));
+            }
+        }
+    }
+    return result;
+}
+
+TrackBitmap TrackBitmap::operator-(const TrackBitmap& other) const {
+    TrackBitmap result;
+    result.m_containers.reserve(m_containers.size());
+
+    auto right = other.m_containers.begin();
+    for (const auto& left : m_containers) {
+        while (right != other.m_containers.end() && right->key < left.key)
+            ++right;
+
+        if (right == other.m_containers.end() || right->key != left.key) {
+            result.m_containers.push_back(left);
+            result.m_size += left.cardinality;
+            continue;
+        }
+
+        Container container = subtract(left, *right);
+        if (container.cardinality > 0) {
+            result.m_size += container.cardinality;
+            result.m_containers.push_back(std::move(container));
+        }
+    }
+    return result;
+}
+
+TrackBitmap& TrackBitmap::operator|=(const TrackBitmap& other) {
+    return *this = *this | other;
+}
+
+TrackBitmap& TrackBitmap::operator&=(const TrackBitmap& other) {
+    return *this = *this & other;
+}
+
+TrackBitmap& TrackBitmap::operator-=(const TrackBitmap& other) {
+    return *this = *this - other;
+}
+
+void TrackBitmap::normalize(Container& container) {
+    if (container.isDense() && container.cardinality <= ArrayLimit) {
+        container.values.clear();
+        container.values.reserve(container.cardinality);
+        for (std::size_t i = 0; i < WordCount; ++i) {
+            for (std::uint64_t word = container.words[i]; word != 0; word &= word - 1)
+                container.values.push_back(static_cast<std::uint16_t>(i * 64 + findLowestBit(word)));
+        }
+        std::vector<std::uint64_t>().swap(container.words);
+    }
+    else if (!container.isDense() && container.cardinality > ArrayLimit) {
+        expand(container, container.words);
+        std::vector<std::uint16_t>().swap(container.values);
+    }
+}
+
+void TrackBitmap::expand(const Container& container, std::vector<std::uint64_t>& words) {
+    if (container.isDense()) {
+        words = container.words;
+        return;
+    }
+
+    words.assign(WordCount, 0);
+    for (std::uint16_t value : container.values)
+        words[value >> 6] |= std::uint64_t(1) << (value & 63);
+}
+
+TrackBitmap::Container TrackBitmap::unite(const Container& left, const Container& right) {
+    Container result;
+    result.key = left.key;
+
+    if (!left.isDense() && !right.isDense()) {
+        result.values.reserve(left.values.size() + right.values.size());
+        std::set_union(left.values.begin(), left.values.end(), right.values.begin(), right.values.end(),
+            std::back_inserter(result.values));
+        result.cardinality = static_cast<std::uint32_t>(result.values.size());
+    }
+    else {
+        // Хотя бы одна сторона плотная: объединение будет плотным или близким к нему.
+        const Container& dense = left.isDense() ? left : right;
+        const Container& other = left.isDense() ? right : left;
+        result.words = dense.words;
+        if (other.isDense()) {
+            for (std::size_t i = 0; i < WordCount; ++i)
+                result.words[i] |= other.words[i];
+        }
+        else {
+            for (std::uint16_t value : other.values)
+                result.words[value >> 6] |= std::uint64_t(1) << (value & 63);
+        }
+        result.cardinality = countWords(result.words);
+    }
+
+    normalize(result);
+    return result;
+}
+
+TrackBitmap::Container TrackBitmap::intersect(const Container& left, const Container& right) {
+    Container result;
+    result.key = left.key;
+
+    if (left.isDense() && right.isDense()) {
+        result.words.resize(WordCount);
+        for (std::size_t i = 0; i < WordCount; ++i)
+            result.words[i] = left.words[i] & right.words[i];
+        result.cardinality = countWords(result.words);
+    }
+    else if (left.isDense() || right.isDense()) {
+        // Пересечение не больше редкой стороны: проверяем ее элементы по битовой карте.
+        const Container& dense = left.isDense() ? left : right;
+        const Container& sparse = left.isDense() ? right : left;
+        result.values.reserve(sparse.values.size());
+        for (std::uint16_t value : sparse.values) {
+            if (dense.contains(value))
+                result.values.push_back(value);
+        }
+        result.cardinality = static_cast<std::uint32_t>(result.values.size());
+    }
+    else {
+        result.values.reserve(std::min(left.values.size(), right.values.size()));
+        std::set_intersection(left.values.begin(), left.values.end(), right.values.begin(), right.values.end(),
+            std::back_inserter(result.values));
+        result.cardinality = static_cast<std::uint32_t>(result.values.size());
+    }
+
+    normalize(result);
+    return result;
+}
+
+TrackBitmap::Container TrackBitmap::subtract(const Container& left, const Container& right) {
+    Container result;
+    result.key = left.key;
+
+    if (left.isDense()) {
+        result.words = left.words;
+        if (right.isDense()) {
+            for (std::size_t i = 0; i < WordCount; ++i)
+                result.words[i] &= ~right.words[i];
+        }
+        else {
+            for (std::uint16_t value : right.values)
+                result.words[value >> 6] &= ~(std::uint64_t(1) << (value & 63));
+        }
+        result.cardinality = countWords(result.words);
+    }
+    else if (right.isDense()) {
+        result.values.reserve(left.values.size());
+        for (std::uint16_t value : left.values) {
+            if (!right.contains(value))
+                result.values.push_back(value);
+        }
+        result.cardinality = static_cast<std::uint32_t>(result.values.size());
+    }
+    else {
+        result.values.reserve(left.values.size());
+        std::set_difference(left.values.begin(), left.values.end(), right.values.begin(), right.values.end(),
+            std::back_inserter(result.values));
+        result.cardinality = static_cast<std::uint32_t>(result.values.size());
+    }
+
+    normalize(result);
+    return result;
+}
+
+const TrackBitmap::Container* TrackBitmap::findContainer(std::uint16_t key) const {
+    auto found = std::lower_bound(m_containers.begin(), m_containers.end(), key,
+        [](const Container& container, std::uint16_t key) { return container.key < key; });
+    return found != m_containers.end() && found->key == key ? &*found : nullptr;
+}
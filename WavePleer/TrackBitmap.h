@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Сжатое множество индексов треков в духе Roaring bitmap.
+// Индекс делится на старшие 16 бит (ключ контейнера) и младшие 16 бит. Редкий контейнер хранит
+// младшие половины отсортированным массивом, плотный (больше 4096 элементов) — битовой картой
+// из 1024 слов. Объединение, пересечение и разность идут по контейнерам с общими ключами, поэтому
+// даже на миллионе треков они сводятся к нескольким десяткам тысяч операций над словами.
+class TrackBitmap {
+public:
+    TrackBitmap();
+
+    // Возвращают false, если множество не изменилось.
+    bool add(std::uint32_t track);
+    bool remove(std::uint32_t track);
+
+    bool contains(std::uint32_t track) const;
+    std::size_t getSize() const;
+    bool isEmpty() const;
+    void clear();
+
+    // Дописывает элементы в values по возрастанию.
+    void getValues(std::vector<std::uint32_t>& values) const;
+
+    TrackBitmap operator|(const TrackBitmap& other) const;
+    TrackBitmap operator&(const TrackBitmap& other) const;
+    TrackBitmap operator-(const TrackBitmap& other) const;
+
+    TrackBitmap& operator|=(const TrackBitmap& other);
+    TrackBitmap& operator&=(const TrackBitmap& other);
+    TrackBitmap& operator-=(const TrackBitmap& other);
+
+private:
+    struct Container {
+        std::uint16_t              key;
+        std::uint32_t              cardinality;
+        std::vector<std::uint16_t> values;   // редкий контейнер: отсортированные младшие половины
+        std::vector<std::uint64_t> words;    // плотный контейнер: битовая карта, иначе пусто
+
+        bool isDense() const;
+        bool contains(std::uint16_t value) const;
+    };
+
+    // Выбирает представление по числу элементов.
+    static void normalize(Container& container);
+    // Битовая карта контейнера любого вида.
+    static void expand(const Container& container, std::vector<std::uint64_t>& words);
+
+    static Container unite(const Container& left, const Container& right);
+    static Container intersect(const Container& left, const Container& right);
+    static Container subtract(const Container& left, const Container& right);
+
+    // Контейнер с ключом или nullptr.
+    const Container* findContainer(std::uint16_t key) const;
+
+    std::vector<Container> m_containers;   // упорядочены по ключу
+    std::size_t            m_size;
+};
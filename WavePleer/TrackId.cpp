@@ -0,0 +1,216 @@
+﻿#include "TrackId.h"
+
+#include <cstring>
+
+#include "MappedFile.h"
+#include "TagReader.h"
+
+namespace {
+    // Сколько байт берется из начала, середины и конца звуковых данных.
+    // Хешировать большие файлы целиком при сканировании медиатеки слишком дорого,
+    // а трех окон и размера хватает, чтобы различать разные записи.
+    const std::uint64_t SampleSize = 64 * 1024;
+
+    const std::uint64_t Prime1 = 11400714785074694791ULL;
+    const std::uint64_t Prime2 = 14029467366897019727ULL;
+    const std::uint64_t Prime3 = 1609587929392839161ULL;
+    const std::uint64_t Prime4 = 9650029242287828579ULL;
+    const std::uint64_t Prime5 = 2870177450012600261ULL;
+
+    std::uint64_t rotateLeft(std::uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    std::uint64_t read64(const unsigned char* data) {
+        std::uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    std::uint32_t read32(const unsigned char* data) {
+        std::uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    std::uint64_t round(std::uint64_t accumulator, std::uint64_t input) {
+        accumulator += input * Prime2;
+        accumulator = rotateLeft(accumulator, 31);
+        return accumulator * Prime1;
+    }
+
+    std::uint64_t mergeRound(std::uint64_t accumulator, std::uint64_t value) {
+        accumulator ^= round(0, value);
+        return accumulator * Prime1 + Prime4;
+    }
+
+    // Потоковый XXH64: данные подаются кусками, результат совпадает с хешем их конкатенации.
+    class Hasher {
+    public:
+        explicit Hasher(std::uint64_t seed)
+            : m_bufferSize(0), m_totalSize(0) {
+            m_lanes[0] = seed + Prime1 + Prime2;
+            m_lanes[1] = seed + Prime2;
+            m_lanes[2] = seed;
+            m_lanes[3] = seed - Prime1;
+            m_seed = seed;
+        }
+
+        void update(const unsigned char* data, std::size_t size) {
+            m_totalSize += size;
+
+            if (m_bufferSize + size < sizeof(m_buffer)) {
+                std::memcpy(m_buffer + m_bufferSize, data, size);
+                m_bufferSize += size;
+                return;
+            }
+
+            if (m_bufferSize > 0) {
+                std::size_t fill = sizeof(m_buffer) - m_bufferSize;
+                std::memcpy(m_buffer + m_bufferSize, data, fill);
+                consume(m_buffer);
+                data += fill;
+                size -= fill;
+                m_bufferSize = 0;
+            }
+
+            while (size >= sizeof(m_buffer)) {
+                consume(data);
+                data += sizeof(m_buffer);
+                size -= sizeof(m_buffer);
+            }
+
+            std::memcpy(m_buffer, data, size);
+            m_bufferSize = size;
+        }
+
+        std::uint64_t finish() const {
+            std::uint64_t hash;
+            if (m_totalSize >= sizeof(m_buffer)) {
+                hash = rotateLeft(m_lanes[0], 1) + rotateLeft(m_lanes[1], 7) +
+                    rotateLeft(m_lanes[2], 12) + rotateLeft(m_lanes[3], 18);
+                for (std::uint64_t lane : m_lanes)
+                    hash = mergeRound(hash, lane);
+            }
+            else {
+                hash = m_seed + Prime5;
+            }
+            hash += m_totalSize;
+
+            const unsigned char* data = m_buffer;
+            std::size_t size = m_bufferSize;
+            while (size >= 8) {
+                hash ^= round(0, read64(data));
+                hash = rotateLeft(hash, 27) * Prime1 + Prime4;
+                data += 8;
+                size -= 8;
+            }
+            if (size >= 4) {
+                hash ^= read32(data) * Prime1;
+                hash = rotateLeft(hash, 23) * Prime2 + Prime3;
+                data += 4;
+                size -= 4;
+            }
+            while (size > 0) {
+                hash ^= *data * Prime5;
+                hash = rotateLeft(hash, 11) * Prime1;
+                ++data;
+                --size;
+            }
+
+            hash ^= hash >> 33;
+            hash *= Prime2;
+            hash ^= hash >> 29;
+            hash *= Prime3;
+            hash ^= hash >> 32;
+            return hash;
+        }
+
+    private:
+        void consume(const unsigned char* data) {
+            for (int i = 0; i < 4; ++i)
+                m_lanes[i] = round(m_lanes[i], read64(data + i * 8));
+        }
+
+        std::uint64_t m_lanes[4];
+        std::uint64_t m_seed;
+        unsigned char m_buffer[32];
+        std::size_t   m_bufferSize;
+        std::uint64_t m_totalSize;
+    };
+
+    bool hashRange(const std::string& path, std::uint64_t offset, std::uint64_t size, Hasher& hasher) {
+        MappedFile file;
+        if (!file.open(path, static_cast<std::size_t>(offset), static_cast<std::size_t>(size)) || file.getSize() < size)
+            return false;
+        hasher.update(file.getData(), static_cast<std::size_t>(size));
+        return true;
+    }
+}
+
+std::uint64_t TrackId::compute(const std::string& path) {
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    if (!TagReader::findAudio(path, offset, size)) {
+        // Формат не распознан — берем файл целиком, теги в таком случае отделить не от чего.
+        MappedFile file;
+        if (!file.open(path, 0, 1))
+            return 0;
+        offset = 0;
+        size = file.getFileSize();
+        if (size == 0)
+            return 0;
+    }
+
+    Hasher hasher(0);
+    unsigned char sizeBytes[8];
+    for (int i = 0; i < 8; ++i)
+        sizeBytes[i] = static_cast<unsigned char>(size >> (i * 8));
+    hasher.update(sizeBytes, sizeof(sizeBytes));
+
+    if (size <= SampleSize * 3) {
+        if (!hashRange(path, offset, size, hasher))
+            return 0;
+    }
+    else {
+        std::uint64_t middle = offset + (size - SampleSize) / 2;
+        std::uint64_t end = offset + size - SampleSize;
+        if (!hashRange(path, offset, SampleSize, hasher) || !hashRange(path, middle, SampleSize, hasher) ||
+            !hashRange(path, end, SampleSize, hasher))
+            return 0;
+    }
+
+    // 0 зарезервирован за «неизвестен».
+    std::uint64_t id = hasher.finish();
+    return id != 0 ? id : 1;
+}
+
+std::string TrackId::format(std::uint64_t id) {
+    static const char Digits[] = "0123456789abcdef";
+    std::string text(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        text[i] = Digits[id & 0xF];
+        id >>= 4;
+    }
+    return text;
+}
+
+std::uint64_t TrackId::parse(const std::string& text) {
+    if (text.size() != 16)
+        return 0;
+
+    std::uint64_t id = 0;
+    for (char c : text) {
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return 0;
+        id = (id << 4) | static_cast<std::uint64_t>(digit);
+    }
+    return id;
+}
@@ -0,0 +1,17 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Постоянный идентификатор трека, вычисленный по звуковым данным без тегов.
+// Не меняется при переименовании, переносе файла и правке тегов, поэтому избранное
+// и другие сохраненные списки хранят его вместо пути.
+class TrackId {
+public:
+    // Идентификатор файла или 0, если файл не удалось прочитать.
+    static std::uint64_t compute(const std::string& path);
+
+    // 16 шестнадцатеричных цифр и обратно; parse возвращает 0 для некорректной строки.
+    static std::string format(std::uint64_t id);
+    static std::uint64_t parse(const std::string& text);
+};
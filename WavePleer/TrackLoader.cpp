@@ -0,0 +1,107 @@
+﻿#include "TrackLoader.h"
+
+#include <iostream>
+
+TrackLoader::TrackLoader()
+    : m_running(true), m_generation(0), m_hasRequest(false), m_pendingIndex(-1), m_pendingGain(1.f), m_inFlight(false), m_readAhead(sf::seconds(4)), m_readyIndex(-1) {
+    m_thread = std::thread(&TrackLoader::run, this);
+}
+
+TrackLoader::~TrackLoader() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+void TrackLoader::request(int trackIndex, const std::string& path, float gain) {
+    std::unique_ptr<Decoder> stale;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Новый номер запроса делает все предыдущие результаты устаревшими.
+        ++m_generation;
+        m_hasRequest = true;
+        m_pendingIndex = trackIndex;
+        m_pendingPath = path;
+        m_pendingGain = gain;
+
+        // Готовый, но еще не забранный трек больше не нужен.
+        stale = std::move(m_ready);
+    }
+    m_condition.notify_one();
+}
+
+void TrackLoader::cancel() {
+    std::unique_ptr<Decoder> stale;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_generation;
+        m_hasRequest = false;
+        stale = std::move(m_ready);
+    }
+}
+
+std::unique_ptr<Decoder> TrackLoader::takeReady(int& trackIndex) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_ready)
+        return nullptr;
+
+    trackIndex = m_readyIndex;
+    return std::move(m_ready);
+}
+
+bool TrackLoader::isBusy() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hasRequest || m_inFlight || m_ready;
+}
+
+void TrackLoader::setReadAhead(sf::Time readAhead) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_readAhead = readAhead;
+}
+
+void TrackLoader::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        // Ждем нового запроса или завершения работы.
+        m_condition.wait(lock, [this] { return !m_running || m_hasRequest; });
+        if (!m_running)
+            break;
+
+        // Забираем запрос, чтобы следующий мог встать в очередь, пока этот открывается.
+        std::uint64_t generation = m_generation;
+        int trackIndex = m_pendingIndex;
+        std::string path = std::move(m_pendingPath);
+        float gain = m_pendingGain;
+        sf::Time readAhead = m_readAhead;
+        m_hasRequest = false;
+        m_inFlight = true;
+        lock.unlock();
+
+        // Открываем файл и декодируем начало трека вне блокировки: на сетевом диске это может занять сотни миллисекунд.
+        auto decoder = std::make_unique<Decoder>();
+        bool opened = decoder->open(path, trackIndex, readAhead, gain);
+
+        lock.lock();
+        m_inFlight = false;
+
+        // За время открытия пришел новый запрос или отмена: результат отбрасываем.
+        if (generation != m_generation) {
+            lock.unlock();
+            decoder.reset();
+            lock.lock();
+            continue;
+        }
+
+        if (!opened) {
+            std::cerr << "Failed to open audio file: " << path << std::endl;
+            continue;
+        }
+
+        m_ready = std::move(decoder);
+        m_readyIndex = trackIndex;
+    }
+}
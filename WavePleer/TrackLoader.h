@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Decoder.h"
+
+// Фоновый загрузчик треков.
+// Открывает и подготавливает декодер в отдельном потоке, чтобы переключение треков не блокировало цикл отрисовки.
+// Каждый новый запрос отменяет предыдущий: результат устаревшего открытия просто отбрасывается.
+class TrackLoader {
+public:
+    TrackLoader();
+    ~TrackLoader();
+
+    TrackLoader(const TrackLoader&) = delete;
+    TrackLoader& operator=(const TrackLoader&) = delete;
+
+    // Ставит трек в очередь на открытие. Незавершенные и ожидающие запросы отменяются.
+    // gain — усиление трека, которое декодер применит к сэмплам (см. Decoder::open).
+    void request(int trackIndex, const std::string& path, float gain = 1.f);
+
+    // Отменяет все незавершенные запросы (например, при нажатии Stop).
+    void cancel();
+
+    // Забирает открытый трек, если он готов. Возвращает nullptr, если готового трека нет.
+    std::unique_ptr<Decoder> takeReady(int& trackIndex);
+
+    // Есть ли запрос, результат которого еще не забран.
+    bool isBusy() const;
+
+    // На сколько декодеры следующих открытых треков забегают вперед воспроизведения (по умолчанию 4 секунды).
+    // Для медленных носителей запас стоит увеличить.
+    void setReadAhead(sf::Time readAhead);
+
+private:
+    void run();
+
+    mutable std::mutex         m_mutex;
+    std::condition_variable    m_condition;
+    std::thread                m_thread;
+    bool                       m_running;
+
+    // Номер последнего запроса. Результат с другим номером считается устаревшим.
+    std::uint64_t              m_generation;
+
+    // Ожидающий запрос.
+    bool                       m_hasRequest;
+    int                        m_pendingIndex;
+    std::string                m_pendingPath;
+    float                      m_pendingGain;
+
+    // Запрос, который сейчас открывается в фоновом потоке.
+    bool                       m_inFlight;
+    sf::Time                   m_readAhead;
+
+    // Готовый к воспроизведению трек.
+    std::unique_ptr<Decoder> m_ready;
+    int                        m_readyIndex;
+};
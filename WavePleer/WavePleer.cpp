@@ -5,8 +5,26 @@
 #include <filesystem>
 #include <vector>
 #include <functional>
-#include <unordered_set>
 #include <fstream>
+#include <cstdlib>
+
+#include "ControlBar.h"
+#include "AllocationCounter.h"
+#include "Animator.h"
+#include "Collections.h"
+#include "CoverCache.h"
+#include "DspNodes.h"
+#include "FavoritesView.h"
+#include "FrameScheduler.h"
+#include "Library.h"
+#include "LibraryIndex.h"
+#include "LibraryScanner.h"
+#include "LibraryWatcher.h"
+#include "LoudnessAnalyzer.h"
+#include "Marquee.h"
+#include "PlaybackEngine.h"
+#include "ReplayGain.h"
+#include "Scene.h"
 
 std::string GetRootPath() {
     // Получаем полный путь текущей рабочей директории
@@ -27,264 +45,212 @@ std::string GetRootPath() {
     return rootPath;
 }
 
-void loadButtonTextures(const std::string& rootPath, const std::vector<std::string>& buttonPaths, std::vector<sf::Texture>& buttonTextures) {
-    for (size_t i = 0; i < buttonPaths.size(); ++i) {
+void loadButtonTextures(const std::string& rootPath, const std::vector<std::string>& buttonPaths, ControlBar& controls) {
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < buttonPaths.size(); ++i)
+        paths.push_back(rootPath + buttonPaths[i]);
 
-        // Проверяем, загружена ли текстура для данной кнопки из файла.
-        if (!buttonTextures[i].loadFromFile(rootPath + buttonPaths[i])) {
-            std::cerr << "Failed to load button texture: " << i << std::endl;
-            exit(1);
-        }
+    // Все иконки загружаются в один атлас: панель рисуется одним вызовом.
+    if (!controls.loadIcons(paths)) {
+        std::cerr << "Failed to load button textures" << std::endl;
+        exit(1);
     }
 }
 
-void setPositionForButtons(const sf::Vector2u& windowSize, std::vector<sf::Sprite>& buttons, float buttonWidth, float buttonSpacing, float buttonMarginBottom) {
+void setPositionForButtons(const sf::Vector2u& windowSize, ControlBar& controls, float buttonWidth, float buttonSpacing, float buttonMarginBottom) {
     // Вычисляем общую ширину блока кнопок с учетом промежутков между кнопками.
-    float totalButtonsWidth = (buttonWidth + buttonSpacing) * buttons.size() - buttonSpacing;
+    float totalButtonsWidth = (buttonWidth + buttonSpacing) * controls.getButtonCount() - buttonSpacing;
 
     // Вычисляем начальную позицию блока кнопок по оси X, чтобы они располагались по центру окна.
     float blockStartX = (windowSize.x - totalButtonsWidth) / 2;
 
     // Устанавливаем позиции для каждой кнопки внутри блока.
-    for (size_t i = 0; i < buttons.size(); ++i) {
-        buttons[i].setPosition(blockStartX + i * (buttonWidth + buttonSpacing), windowSize.y - buttonMarginBottom - buttonWidth);
+    for (size_t i = 0; i < controls.getButtonCount(); ++i) {
+        controls.setButtonPosition(i, sf::Vector2f(blockStartX + i * (buttonWidth + buttonSpacing), windowSize.y - buttonMarginBottom - buttonWidth));
     }
 }
 
-void handleButtonPress(sf::Sprite& button, float targetAlpha) {
-    // Получаем оригинальный цвет кнопки.
-    sf::Color originalColor = button.getColor();
+void setButtonAlpha(void* controls, int button, float alpha) {
+    // Меняем только альфа-канал цвета вершин кнопки: текстура и остальная панель не меняются.
+    static_cast<ControlBar*>(controls)->setButtonAlpha(button, static_cast<sf::Uint8>(alpha));
+}
+
+void handleButtonPress(ControlBar& controls, Animator& animator, size_t button, float startAlpha, float targetAlpha) {
+    // Прозрачность кнопки плавно меняется за четверть секунды, кнопки анимируются независимо.
+    animator.start(&controls, static_cast<int>(button), &setButtonAlpha, startAlpha, targetAlpha, sf::seconds(0.25f));
+}
 
-    // Устанавливаем новый цвет кнопки с тем же значением RGB, но изменяем альфа-канал (прозрачность).
-    button.setColor(sf::Color(originalColor.r, originalColor.g, originalColor.b, static_cast<sf::Uint8>(targetAlpha)));
+void loadLibraryIndex(const std::string& indexPath, LibraryIndex& libraryIndex, Library& library) {
+    // Индекса еще нет: медиатека заполнится по мере обхода.
+    if (!libraryIndex.open(indexPath))
+        return;
+
+    // Добавляем все файлы из индекса. Отличия от диска потом найдет LibraryScanner.
+    for (std::size_t directory = 0; directory < libraryIndex.getDirectoryCount(); ++directory) {
+        std::size_t first = libraryIndex.getFirstFile(directory);
+        std::size_t last = first + libraryIndex.getFileCount(directory);
+        for (std::size_t file = first; file < last; ++file)
+            library.add(libraryIndex.getFilePath(directory, file), libraryIndex.getFileInfo(file));
+    }
 }
 
-void loadAudioFiles(const std::string& folderPath, std::vector<std::string>& audioFiles) {
-    // Перебираем все файлы и поддиректории в указанной директории (folderPath).
-    for (const auto& entry : std::filesystem::directory_iterator(folderPath)) {
-        // Получаем путь к текущему файлу или поддиректории.
-        std::string filePath = entry.path().string();
+sf::String getTrackTitle(const Library& library, int trackIndex) {
+    // Без тегов показываем имя файла.
+    const TrackInfo& info = library.getInfo(trackIndex);
+    if (info.title.empty())
+        return sf::String(std::filesystem::path(library.getPath(trackIndex)).filename().wstring());
 
-        // Проверяем, что файл имеет расширение ".mp3".
-        if (filePath.substr(filePath.find_last_of(".") + 1) == "mp3") {
+    std::string title = info.artist.empty() ? info.title : info.artist + " - " + info.title;
+    return sf::String::fromUtf8(title.begin(), title.end());
+}
 
-            // Добавляем его путь в вектор audioFiles.
-            audioFiles.push_back(filePath);
-        }
+std::vector<std::string> getLibraryRoots(int argc, char* argv[]) {
+    // Каталоги медиатеки передаются в командной строке.
+    std::vector<std::string> roots(argv + 1, argv + argc);
+
+    // По умолчанию используем папку "Музыка" текущего пользователя.
+    if (roots.empty()) {
+        const char* home = std::getenv("USERPROFILE");
+        if (!home)
+            home = std::getenv("HOME");
+        if (home)
+            roots.push_back((std::filesystem::path(home) / "Music").string());
     }
+
+    return roots;
 }
 
-void handlePlayButtonPress(sf::Music& music, const std::vector<std::string>& audioFiles, int& currentTrackIndex, sf::Sprite& button, std::vector<sf::Sprite>& buttons, sf::Clock& fadeTimer, sf::Sprite*& activeButton) {
-    // Проверяем, что вектор audioFiles не пустой.
-    if (!audioFiles.empty()) {
-        // Открываем и воспроизводим выбранный аудиофайл.
-        music.openFromFile(audioFiles[currentTrackIndex]);
-        music.play();
+void handlePlayButtonPress(PlaybackEngine& engine, const Library& library, int& currentTrackIndex, ControlBar& controls, size_t button, Animator& animator, int& activeButton) {
+    // Проверяем, что медиатека не пуста.
+    if (!library.isEmpty()) {
+        // Выбранный трек мог быть удален с диска: берем следующий существующий.
+        if (library.getPath(currentTrackIndex).empty())
+            currentTrackIndex = library.getNext(currentTrackIndex);
+
+        // Открываем выбранный аудиофайл в фоне, воспроизведение начнется в PlaybackEngine::update.
+        engine.playTrack(currentTrackIndex);
 
         // Проверяем активность кнопки (activeButton)
-        if (activeButton != &button) {
+        if (activeButton != static_cast<int>(button)) {
 
             // Устанавливаем прозрачность для всех кнопок (кроме текущей) в прозрачное состояние.
-            handleButtonPress(button, 0);
-            for (size_t j = 1; j < buttons.size(); ++j)
-                handleButtonPress(buttons[j], 0.5 * 255);
-            activeButton = &button;
-
-            // Запускаем таймер затухания.
-            fadeTimer.restart();
+            handleButtonPress(controls, animator, button, 0, 255);
+            for (size_t j = 1; j < controls.getButtonCount(); ++j)
+                handleButtonPress(controls, animator, j, controls.getButtonAlpha(j), 0.5 * 255);
+            activeButton = static_cast<int>(button);
         }
     }
 }
 
-void handleStopButtonPress(sf::Music& music, sf::Sprite& button, std::vector<sf::Sprite>& buttons, sf::Clock& fadeTimer, sf::Sprite*& activeButton) {
-    // Останавливаем воспроизведение музыки.
-    music.stop();
-    if (activeButton != &button) {
-        handleButtonPress(button, 0);
-        for (size_t j = 0; j < buttons.size(); ++j) {
-            if (&buttons[j] != &button)
-                handleButtonPress(buttons[j], 0.5 * 255);
+void handleStopButtonPress(PlaybackEngine& engine, ControlBar& controls, size_t button, Animator& animator, int& activeButton) {
+    // Останавливаем воспроизведение музыки и отменяем незавершенное открытие.
+    engine.stopPlayback();
+    if (activeButton != static_cast<int>(button)) {
+        handleButtonPress(controls, animator, button, 0, 255);
+        for (size_t j = 0; j < controls.getButtonCount(); ++j) {
+            if (j != button)
+                handleButtonPress(controls, animator, j, controls.getButtonAlpha(j), 0.5 * 255);
         }
-        activeButton = &button;
-        fadeTimer.restart();
+        activeButton = static_cast<int>(button);
     }
 }
 
-void handleNextButtonPress(sf::Music& music, const std::vector<std::string>& audioFiles, int& currentTrackIndex, sf::Sprite& button, std::vector<sf::Sprite>& buttons, sf::Clock& fadeTimer, sf::Sprite*& activeButton) {
-    if (!audioFiles.empty()) {
-        // Останавливаем воспроизведение музыки.
-        music.stop();
-
+void handleNextButtonPress(PlaybackEngine& engine, const Library& library, int& currentTrackIndex, ControlBar& controls, size_t button, Animator& animator, int& activeButton) {
+    if (!library.isEmpty()) {
         // Переключиться на следующий трек в списке плейлиста
-        currentTrackIndex = (currentTrackIndex + 1) % audioFiles.size();
-
-        // Открыть новый трек для воспроизведения.
-        music.openFromFile(audioFiles[currentTrackIndex]);
-
-        // Воспроизвести новый трек.
-        music.play();
-        if (activeButton != &button) {
-            handleButtonPress(button, 0);
-            for (size_t j = 0; j < buttons.size(); ++j) {
-                if (&buttons[j] != &button)
-                    handleButtonPress(buttons[j], 0.5 * 255);
+        currentTrackIndex = library.getNext(currentTrackIndex);
+
+        // Открыть новый трек в фоне. Текущий трек играет, пока новый не будет готов.
+        engine.playTrack(currentTrackIndex);
+        if (activeButton != static_cast<int>(button)) {
+            handleButtonPress(controls, animator, button, 0, 255);
+            for (size_t j = 0; j < controls.getButtonCount(); ++j) {
+                if (j != button)
+                    handleButtonPress(controls, animator, j, controls.getButtonAlpha(j), 0.5 * 255);
             }
-            activeButton = &button;
-            fadeTimer.restart();
+            activeButton = static_cast<int>(button);
         }
     }
 }
 
-void handlePreviousButtonPress(sf::Music& music, const std::vector<std::string>& audioFiles, int& currentTrackIndex, sf::Sprite& button, std::vector<sf::Sprite>& buttons, sf::Clock& fadeTimer, sf::Sprite*& activeButton) {
-    if (!audioFiles.empty()) {
-        // Останавливаем воспроизведение музыки.
-        music.stop();
-
+void handlePreviousButtonPress(PlaybackEngine& engine, const Library& library, int& currentTrackIndex, ControlBar& controls, size_t button, Animator& animator, int& activeButton) {
+    if (!library.isEmpty()) {
         // Переключиться на предыдущий трек в списке плейлиста
-        currentTrackIndex = (currentTrackIndex - 1 + audioFiles.size()) % audioFiles.size();
-
-        // Открыть новый трек для воспроизведения.
-        music.openFromFile(audioFiles[currentTrackIndex]);
-
-        // Воспроизвести новый трек.
-        music.play();
-        if (activeButton != &button) {
-            handleButtonPress(button, 0);
-            for (size_t j = 0; j < buttons.size(); ++j) {
-                if (&buttons[j] != &button)
-                    handleButtonPress(buttons[j], 0.5 * 255);
+        currentTrackIndex = library.getPrevious(currentTrackIndex);
+
+        // Открыть новый трек в фоне. Текущий трек играет, пока новый не будет готов.
+        engine.playTrack(currentTrackIndex);
+        if (activeButton != static_cast<int>(button)) {
+            handleButtonPress(controls, animator, button, 0, 255);
+            for (size_t j = 0; j < controls.getButtonCount(); ++j) {
+                if (j != button)
+                    handleButtonPress(controls, animator, j, controls.getButtonAlpha(j), 0.5 * 255);
             }
-            activeButton = &button;
-            fadeTimer.restart();
+            activeButton = static_cast<int>(button);
         }
     }
 }
 
-void saveFavoritesToFile(const std::string& filePath, const std::unordered_set<std::string>& favorites) {
-    // Открываем файл для записи.
-    std::ofstream file(filePath);
-
-    // Проверяем, удалось ли открыть файл.
-    if (file.is_open()) {
-
-        // Перебираем все элементы множества favorites и записываем их в файл.
-        for (const auto& track : favorites) {
-
-            // Записываем элемент и добавляем символ новой строки.
-            file << track << std::endl;
-        }
-        file.close();
-    }
-    else {
-        std::cerr << "Failed to open favorites file for writing: " << filePath << std::endl;
-    }
+void handleCrossfadeKeyPress(PlaybackEngine& engine) {
+    // Переключаем длительность наложения треков по кругу: 0, 3, 6, 9 и 12 секунд.
+    int seconds = (static_cast<int>(engine.getCrossfade().asSeconds()) + 3) % 15;
+    engine.setCrossfade(sf::seconds(static_cast<float>(seconds)));
+    std::cout << "Crossfade: " << seconds << " s" << std::endl;
 }
 
-void loadFavoritesFromFile(const std::string& filePath, std::unordered_set<std::string>& favorites) {
-    // Открываем файл для чтения.
-    std::ifstream file(filePath);
-
-    // Проверяем, удалось ли открыть файл.
-    if (file.is_open()) {
-        std::string line;
-
-        // Считываем файл построчно и добавляем каждую строку в множество favorites.
-        while (std::getline(file, line)) {
-            favorites.insert(line);
-        }
-        file.close();
+void handleEqualizerKeyPress(EqualizerNode& equalizer, size_t& equalizerPreset, bool isShiftPressed) {
+    // E переключает настройки эквалайзера по кругу, Shift+E включает и выключает его
+    if (isShiftPressed) {
+        equalizer.setEnabled(!equalizer.isEnabled());
+        std::cout << "Equalizer: " << (equalizer.isEnabled() ? "on" : "off") << std::endl;
+        return;
     }
-    else {
-        std::cerr << "Failed to open favorites file for reading: " << filePath << std::endl;
-    }
-}
-
-void handleFavoriteButtonPress(const std::string& currentTrack, std::unordered_set<std::string>& favorites, const std::string& favoritesFilePath) {
-    // Проверяем, не содержится ли текущий трек уже в избранном.
-    if (favorites.find(currentTrack) == favorites.end()) {
-
-        // Если трек не содержится в избранном, добавляем его.
-        favorites.insert(currentTrack);
 
-        // Сохраняем обновленный список избранных в файл.
-        saveFavoritesToFile(favoritesFilePath, favorites);
-        std::cout << "Added to favorites: " << currentTrack << std::endl;
-    }
-    else {
-        std::cout << "Track is already in favorites: " << currentTrack << std::endl;
-    }
+    equalizerPreset = (equalizerPreset + 1) % EqualizerNode::getPresetCount();
+    equalizer.applyPreset(equalizerPreset);
+    std::cout << "Equalizer preset: " << EqualizerNode::getPresetName(equalizerPreset) << std::endl;
 }
 
-void displayFavoritesScreen(sf::RenderWindow& window, const std::unordered_set<std::string>& favorites, sf::Font& font) {
-    // Создаем текстовый объект для отображения списка избранных треков.
-    sf::Text favoritesText;
-
-    // Настройки объекта текста
-    favoritesText.setFont(font);
-    favoritesText.setFillColor(sf::Color::Black);
-    favoritesText.setCharacterSize(24);
-    favoritesText.setStyle(sf::Text::Bold);
-    favoritesText.setPosition(50, 50);
-
-    // Формируем строку для списка избранных треков.
-    std::string favoritesList = "Favorites:\n";
-    for (const auto& track : favorites) {
-
-        // Извлекаем имя файла из полного пути к треку и добавляем его к списку.
-        favoritesList += std::filesystem::path(track).filename().string() + "\n";
-    }
-
-    // Устанавливаем сформированную строку в текстовый объект.
-    favoritesText.setString(favoritesList);
-
-    // Основной цикл отображения экрана избранных треков.
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed) {
-                window.close();
-            }
-            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Escape) {
-                return;
-            }
-        }
-
-        window.clear(sf::Color::White);
-        window.draw(favoritesText);
-        window.display();
-    }
+void handleReplayGainKeyPress(ReplayGain& replayGain) {
+    // Переключаем выравнивание громкости по кругу: выключено, по трекам, по альбомам.
+    // Новый режим действует со следующего открытого трека
+    static const char* const modeNames[] = { "off", "track", "album" };
+    ReplayGain::Mode mode = static_cast<ReplayGain::Mode>((replayGain.getMode() + 1) % 3);
+    replayGain.setMode(mode);
+    std::cout << "ReplayGain: " << modeNames[mode] << std::endl;
 }
 
+void handleDspReportKeyPress(PlaybackEngine& engine) {
+    // Доля реального времени звука, потраченная каждым узлом с прошлого отчета.
+    std::vector<float> loads;
+    DspChain& dsp = engine.getDsp();
+    dsp.takeLoads(loads);
+    for (size_t i = 0; i < dsp.getNodeCount(); ++i)
+        std::cout << dsp.getNode(i).getName() << ": " << loads[i] * 100.f << "%" << std::endl;
+    std::cout << "Format conversion: " << loads.back() * 100.f << "%" << std::endl;
+}
 
-void loadImages(const std::string& rootPath, std::vector<sf::Texture>& images) {
-    // Формируем путь к каталогу с обложками (covers).
-    std::string coversPath = rootPath + "\\Covers";
-
-    // Переменная для индекса изображения.
-    int index = 0;
-
-    // Итерируем по содержимому каталога с обложками.
-    for (const auto& entry : std::filesystem::directory_iterator(coversPath)) {
-        std::string filePath = entry.path().string();
-        if (filePath.substr(filePath.find_last_of(".") + 1) == "png") {
-            // Создаем текстуру для загрузки изображения.
-            sf::Texture texture;
-
-            // Загружаем изображение (текстуру) из файла.
-            if (texture.loadFromFile(filePath)) {
-                images.push_back(texture);
-                index++;
-            }
-        }
+void handleCollectionToggle(const Library& library, int currentTrackIndex, Collections& collections, std::size_t collection) {
+    // Коллекции хранят идентификатор содержимого, а не путь: так трек остается в них после переноса.
+    const std::string& currentTrack = library.getPath(currentTrackIndex);
+    if (library.getInfo(currentTrackIndex).id == 0) {
+        std::cout << "Can't add to " << collections.getName(collection) << ", failed to read: " << currentTrack << std::endl;
+        return;
     }
+
+    // Повторное нажатие убирает трек из коллекции. Изменение дописывается в журнал одной строкой.
+    if (collections.toggle(collection, currentTrackIndex, library))
+        std::cout << "Added to " << collections.getName(collection) << ": " << currentTrack << std::endl;
+    else
+        std::cout << "Removed from " << collections.getName(collection) << ": " << currentTrack << std::endl;
 }
 
-void setPositionForImage(sf::RenderWindow& window, sf::Sprite& imageSprite, const sf::RectangleShape& volumeSlider) {
+void setPositionForImage(sf::RenderWindow& window, sf::Sprite& imageSprite, const ControlBar& controls) {
     // Получаем размеры окна
     sf::Vector2u windowSize = window.getSize();
 
-    // Получаем глобальные границы спрайта изображения
-    sf::FloatRect imageBounds = imageSprite.getGlobalBounds();
+    // Получаем границы изображения без учета масштаба: у обложек разные размеры
+    sf::FloatRect imageBounds = imageSprite.getLocalBounds();
 
     // Размер изображения
     sf::Vector2f desiredSize(420.f, 420.f);
@@ -304,55 +270,78 @@ void setPositionForImage(sf::RenderWindow& window, sf::Sprite& imageSprite, cons
 
     // Вычисляем позицию спрайта изображения
     imageSprite.setPosition((windowSize.x - imageBounds.width) / 2,
-        volumeSlider.getPosition().y - 120 - imageBounds.height);
+        controls.getSliderBounds().top - 120 - imageBounds.height);
+}
+
+void setCoverImage(sf::RenderWindow& window, sf::Sprite& imageSprite, const ControlBar& controls, const sf::Texture* cover) {
+    // Без текстуры спрайт ничего не рисует.
+    if (!cover) {
+        imageSprite = sf::Sprite();
+        return;
+    }
+
+    imageSprite.setTexture(*cover, true);
+    setPositionForImage(window, imageSprite, controls);
 }
 
-void processEvents(sf::RenderWindow& window, std::vector<sf::Sprite>& buttons, sf::Music& music, std::vector<std::string>& audioFiles, int& currentTrackIndex, sf::Clock& fadeTimer, sf::Sprite*& activeButton, sf::RectangleShape& volumeSlider, sf::CircleShape& volumeIndicator, bool& isVolumeIndicatorDragged, std::vector<sf::Texture>& images, int& currentImageIndex, sf::Sprite& imageSprite, std::unordered_set<std::string>& favorites, const std::string& favoritesFilePath, sf::Font& font) {
+bool processEvents(sf::RenderWindow& window, ControlBar& controls, PlaybackEngine& engine, Library& library, int& currentTrackIndex, Animator& animator, int& activeButton, bool& isVolumeIndicatorDragged, Collections& collections, FavoritesView& favoritesView, Scene& scene, EqualizerNode& equalizer, size_t& equalizerPreset, ReplayGain& replayGain, GainNode& volume) {
     sf::Event event;
+    bool hasEvents = false;
+
+    // Перемещения мыши за кадр сводятся к последнему: ползунок и громкость обновляются один раз
+    bool isVolumeMoved = false;
+    int volumeMouseX = 0;
 
     // Обрабатываем все события в очереди
     while (window.pollEvent(event)) {
+        hasEvents = true;
+
         // Обработка события закрытия окна
         if (event.type == sf::Event::Closed)
             window.close();
 
+        // Пока открыт экран избранного, события получает он, а плеер продолжает работать
+        if (favoritesView.isOpen()) {
+            if (event.type == sf::Event::MouseButtonReleased)
+                isVolumeIndicatorDragged = false;
+            favoritesView.handleEvent(event);
+            continue;
+        }
+
         // Обработка события нажатия кнопки мыши
         if (event.type == sf::Event::MouseButtonPressed) {
 
             // Проверяем нажатие на кнопки
             if (event.mouseButton.button == sf::Mouse::Left) {
-                for (size_t i = 0; i < buttons.size(); ++i) {
-                    if (buttons[i].getGlobalBounds().contains(sf::Vector2f(event.mouseButton.x, event.mouseButton.y))) {
+                for (size_t i = 0; i < controls.getButtonCount(); ++i) {
+                    if (controls.getButtonBounds(i).contains(sf::Vector2f(event.mouseButton.x, event.mouseButton.y))) {
                         switch (i) {
                         case 0: // Play button
-                            handlePlayButtonPress(music, audioFiles, currentTrackIndex, buttons[0], buttons, fadeTimer, activeButton);
+                            handlePlayButtonPress(engine, library, currentTrackIndex, controls, 0, animator, activeButton);
                             break;
                         case 1: // Stop button
-                            handleStopButtonPress(music, buttons[1], buttons, fadeTimer, activeButton);
+                            handleStopButtonPress(engine, controls, 1, animator, activeButton);
                             break;
                         case 2: // Next button
-                            handleNextButtonPress(music, audioFiles, currentTrackIndex, buttons[2], buttons, fadeTimer, activeButton);
-                            currentImageIndex = (currentImageIndex + 1) % images.size();
-                            imageSprite.setTexture(images[currentImageIndex]);
-                            setPositionForImage(window, imageSprite, volumeSlider);
+                            handleNextButtonPress(engine, library, currentTrackIndex, controls, 2, animator, activeButton);
                             break;
                         case 3: // Previous button
-                            handlePreviousButtonPress(music, audioFiles, currentTrackIndex, buttons[3], buttons, fadeTimer, activeButton);
-                            currentImageIndex = (currentImageIndex - 1 + images.size()) % images.size();
-                            imageSprite.setTexture(images[currentImageIndex]);
-                            setPositionForImage(window, imageSprite, volumeSlider);
+                            handlePreviousButtonPress(engine, library, currentTrackIndex, controls, 3, animator, activeButton);
                             break;
                         case 4: // Favorite button
-                            if (!audioFiles.empty()) {
-                                handleFavoriteButtonPress(audioFiles[currentTrackIndex], favorites, favoritesFilePath);
+                            if (!library.getPath(currentTrackIndex).empty()) {
+                                handleCollectionToggle(library, currentTrackIndex, collections, Collections::Favorites);
                             }
                             break;
                         }
+
+                        // Обработчики меняют прозрачность всех кнопок
+                        scene.invalidate(controls);
                     }
                 }
 
                 // Проверяем нажатие на индикатор громкости
-                if (volumeIndicator.getGlobalBounds().contains(event.mouseButton.x, event.mouseButton.y)) {
+                if (controls.getIndicatorBounds().contains(event.mouseButton.x, event.mouseButton.y)) {
                     isVolumeIndicatorDragged = true;
                 }
             }
@@ -368,107 +357,160 @@ void processEvents(sf::RenderWindow& window, std::vector<sf::Sprite>& buttons, s
         // Обработка события перемещения мыши
         else if (event.type == sf::Event::MouseMoved) {
             if (isVolumeIndicatorDragged) {
-                float newX = event.mouseMove.x - volumeSlider.getPosition().x;
-                newX = std::max(0.f, std::min(newX, volumeSlider.getSize().x));
-                float volumePercentage = newX / volumeSlider.getSize().x;
-                volumeIndicator.setPosition(volumeSlider.getPosition().x + newX, volumeIndicator.getPosition().y);
-                music.setVolume(volumePercentage * 100);
+                isVolumeMoved = true;
+                volumeMouseX = event.mouseMove.x;
             }
         }
 
         // Обработка события нажатия клавиши F для отображения списка избранного
         else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F) {
-            displayFavoritesScreen(window, favorites, font);
+            favoritesView.open(collections.getName(Collections::Favorites), collections.getTracks(Collections::Favorites), library);
+        }
+
+        // Цифры 1-9 добавляют текущий трек в коллекцию с этим номером или убирают его оттуда,
+        // с Shift — открывают список коллекции
+        else if (event.type == sf::Event::KeyPressed && event.key.code >= sf::Keyboard::Num1 && event.key.code <= sf::Keyboard::Num9) {
+            std::size_t collection = static_cast<std::size_t>(event.key.code - sf::Keyboard::Num0);
+            if (collection < collections.getCount()) {
+                if (event.key.shift)
+                    favoritesView.open(collections.getName(collection), collections.getTracks(collection), library);
+                else if (!library.getPath(currentTrackIndex).empty())
+                    handleCollectionToggle(library, currentTrackIndex, collections, collection);
+            }
+        }
+
+        // Обработка события нажатия клавиши C для переключения длительности наложения треков
+        else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::C) {
+            handleCrossfadeKeyPress(engine);
         }
+
+        // Обработка события нажатия клавиши E для выбора настройки эквалайзера
+        else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::E) {
+            handleEqualizerKeyPress(equalizer, equalizerPreset, event.key.shift);
+        }
+
+        // Обработка события нажатия клавиши D для отчета о нагрузке цепочки обработки звука
+        else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::D) {
+            handleDspReportKeyPress(engine);
+        }
+
+        // Обработка события нажатия клавиши G для выбора режима выравнивания громкости
+        else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::G) {
+            handleReplayGainKeyPress(replayGain);
+        }
+    }
+
+    // Громкость меняется в цепочке обработки звука плавно, без обращений к OpenAL
+    if (isVolumeMoved) {
+        sf::FloatRect volumeSlider = controls.getSliderBounds();
+        float newX = volumeMouseX - volumeSlider.left;
+        newX = std::max(0.f, std::min(newX, volumeSlider.width));
+        controls.setIndicatorPosition(sf::Vector2f(volumeSlider.left + newX, controls.getIndicatorPosition().y));
+        scene.invalidate(controls);
+        volume.setGain(newX / volumeSlider.width);
     }
+
+    return hasEvents;
 }
 
-void draw(sf::RenderWindow& window, const std::vector<sf::Sprite>& buttons, const sf::Text& trackNameText, const sf::RectangleShape& volumeSlider, const sf::CircleShape& volumeIndicator, const sf::Sprite& imageSprite) {
-    // Очищаем окно, заполняя его белым цветом
-    window.clear(sf::Color::White);
-    
-    // Отрисовываем обьекты
-    for (const auto& button : buttons)
-        window.draw(button);
-    window.draw(trackNameText);
-    window.draw(volumeSlider);
-    window.draw(volumeIndicator);
-    window.draw(imageSprite);
+void draw(sf::RenderWindow& window, Scene& scene, const FavoritesView& favoritesView) {
+    if (favoritesView.isOpen()) {
+        // Экран избранного закрывает плеер целиком; кэш сцены при этом не меняется
+        window.clear(sf::Color::White);
+        window.draw(favoritesView);
+    }
+    else {
+        // Перерисовываем только изменившиеся области, остальное окно берется из кэша сцены
+        scene.render(window);
+    }
     window.display();
 }
 
 int main(int argc, char* argv[]) {
     std::string rootPath = GetRootPath();
-    std::string folderPath = "C:\\Users\\Grotti\\Music";
 
-    // Вектор для хранения путей к аудиофайлам
-    std::vector<std::string> audioFiles;
+    // В сборке с подсчетом выделений программа может работать как проверка (см. AllocationCounter)
+    AllocationCounter::startCheck();
+    bool isCheckTrackStarted = false;
+
+    // Медиатека: пути к аудиофайлам
+    Library library;
+
+    // Загружаем медиатеку из индекса прошлого запуска, чтобы она была доступна сразу
+    std::string libraryIndexPath = rootPath + "\\library.idx";
+    LibraryIndex libraryIndex;
+    loadLibraryIndex(libraryIndexPath, libraryIndex, library);
 
-    // Множество для хранения избранных аудиофайлов
-    std::unordered_set<std::string> favorites;
+    // Запускаем фоновую сверку медиатеки с диском: изменения применяются по мере обхода
+    std::vector<std::string> libraryRoots = getLibraryRoots(argc, argv);
+    LibraryScanner libraryScanner(libraryRoots, libraryIndex, libraryIndexPath);
+    bool isLibraryIndexSaved = false;
 
-    // Загружаем список аудиофайлов из указанной папки
-    loadAudioFiles(folderPath, audioFiles);
+    // Следим за каталогами медиатеки, чтобы новые и удаленные файлы появлялись без перезапуска
+    LibraryWatcher libraryWatcher(libraryRoots);
 
     // Создаем графическое окно для отображения интерфейса
     sf::RenderWindow window(sf::VideoMode(600, 800), "Audio Player");
 
+    // Окно перерисовывается только при изменениях, а без них цикл спит до события
+    FrameScheduler frameScheduler(window);
+
+    // Пока фоновые задачи заняты, их результаты забираются не реже этого периода
+    const sf::Time backgroundPollInterval = sf::milliseconds(20);
+
+    // Изменения каталогов медиатеки приходят пачками, их достаточно проверять несколько раз в секунду
+    const sf::Time libraryPollInterval = sf::milliseconds(250);
+
     // Загружаем текстуры для кнопок управления
-    std::vector<sf::Texture> buttonTextures(5);
-    std::vector<sf::Sprite> buttons(5);
+    ControlBar controls;
     std::vector<std::string> buttonPaths = { "\\Assets\\play-button.png", "\\Assets\\pause-button.png", "\\Assets\\previous-button.png", "\\Assets\\next-button.png", "\\Assets\\favorite-button.png" };
-    loadButtonTextures(rootPath, buttonPaths, buttonTextures);
+    loadButtonTextures(rootPath, buttonPaths, controls);
 
     // Устанавливаем позиции для кнопок на экране
     float buttonWidth = 64;
     float buttonSpacing = 54;
     float buttonMarginBottom = 100;
 
-    // Устанавливаем текстуры для кнопок
-    for (size_t i = 0; i < buttons.size(); ++i) {
-        buttons[i].setTexture(buttonTextures[i]);
-    }
+    setPositionForButtons(window.getSize(), controls, buttonWidth, buttonSpacing, buttonMarginBottom);
 
-    setPositionForButtons(window.getSize(), buttons, buttonWidth, buttonSpacing, buttonMarginBottom);
-
-    // Инициализируем объект для воспроизведения музыки
-    sf::Music music;
+    // Инициализируем движок воспроизведения, который сам переходит к следующему треку без паузы
+    PlaybackEngine engine(library);
     int currentTrackIndex = 0;
 
-    // Таймер для эффекта затухания кнопок
-    sf::Clock buttonTimer;
-    sf::Clock fadeTimer;
-    float fadeDuration = 0.25f;
-    sf::Sprite* activeButton = nullptr;
+    // Цепочка обработки звука между декодером и OpenAL
+    DspChain& dsp = engine.getDsp();
+    dsp.add(std::make_unique<GainNode>("Pre-amp"));
+    EqualizerNode& equalizer = dsp.add(std::make_unique<EqualizerNode>());
+    size_t equalizerPreset = 0;
+    dsp.add(std::make_unique<BalanceNode>());
+    dsp.add(std::make_unique<LimiterNode>());
+    GainNode& volume = dsp.add(std::make_unique<GainNode>("Gain"));
+
+    // Анимации затухания кнопок и последняя нажатая кнопка
+    Animator animator;
+    int activeButton = -1;
 
     // Создаем ползунок громкости
-    sf::RectangleShape volumeSlider(sf::Vector2f(buttons.size() * (buttonWidth + buttonSpacing) - buttonSpacing, 5));
-    volumeSlider.setFillColor(sf::Color::Black);
-    volumeSlider.setPosition(buttons[0].getPosition().x, buttons[0].getPosition().y - 30);
+    sf::Vector2f firstButton = controls.getButtonPosition(0);
+    sf::Vector2f volumeSliderSize(controls.getButtonCount() * (buttonWidth + buttonSpacing) - buttonSpacing, 5);
+    controls.setSlider(sf::Vector2f(firstButton.x, firstButton.y - 30), volumeSliderSize);
 
     // Создаем индикатор громкости
-    sf::CircleShape volumeIndicator(10);
-    volumeIndicator.setFillColor(sf::Color::Black);
-    volumeIndicator.setOrigin(10, 10);
-    volumeIndicator.setPosition(buttons[0].getPosition().x + volumeSlider.getSize().x, buttons[0].getPosition().y - 30);
+    controls.setIndicatorPosition(sf::Vector2f(firstButton.x + volumeSliderSize.x, firstButton.y - 30));
 
     // Переменная перетаскивания индикатора громкости
     bool isVolumeIndicatorDragged = false;
 
-    // Загружаем изображения для отображения
-    std::vector<sf::Texture> images;
-    loadImages(rootPath, images);
-
-    // Индекс изображения
-    int currentImageIndex = 0;
-
     sf::Sprite imageSprite;
 
-    // Устанавливаем изображение, если оно доступно
-    if (!images.empty()) {
-        imageSprite.setTexture(images[currentImageIndex]);
-        setPositionForImage(window, imageSprite, volumeSlider);
-    }
+    // Обложки треков ищутся и декодируются в фоне, треки одного альбома используют одну текстуру.
+    // Эскизы хранятся на диске в размере, в котором обложка показывается (см. setPositionForImage).
+    // Треки без обложки получают одно из изображений каталога Covers, оно тоже загружается только по запросу
+    CoverCache coverCache(rootPath + "\\Thumbnails", rootPath + "\\Covers", 420);
+
+    // Время кадра, которое можно потратить на загрузку обложек в видеопамять
+    sf::Time coverUploadBudget = sf::milliseconds(2);
+    int coverTrackIndex = -1;
 
     // Загружаем шрифт для отображения текста
     sf::Font font;
@@ -478,44 +520,174 @@ int main(int argc, char* argv[]) {
     }
 
     // Текст для отображения имени текущего трека
-    sf::Text trackNameText("", font, 20);
-    trackNameText.setFillColor(sf::Color::Black);
-    trackNameText.setStyle(sf::Text::Bold);
-    trackNameText.setPosition(buttons[0].getPosition().x, buttons[0].getPosition().y - 30 - 30);
-
-    // Загружаем избранные треки из файла
-    std::string favoritesFilePath = rootPath + "\\favorites.txt";
-    loadFavoritesFromFile(favoritesFilePath, favorites);
+    // Строка размечается один раз при смене трека, а бежит по времени, а не по числу кадров
+    Marquee trackNameText;
+    trackNameText.setStyle(font, 20, sf::Color::Black, sf::Text::Bold);
+    trackNameText.setArea(sf::FloatRect(0.f, firstButton.y - 100, static_cast<float>(window.getSize().x), 40.f));
+    trackNameText.setSpeed(60.f);
+    int titleTrackIndex = -1;
+    sf::Clock marqueeClock;
+
+    // Сцена окна в порядке отрисовки: перерисовываются только изменившиеся объекты
+    Scene scene(window.getSize(), sf::Color::White);
+    scene.add(controls);
+    scene.add(trackNameText);
+    scene.add(imageSprite);
+
+    // Загружаем избранное и коллекции
+    // Изменения дописываются в журналы, а снимки файлов пересобираются в фоне
+    Collections collections(rootPath + "\\favorites.txt", rootPath + "\\collections");
+    collections.load();
+    collections.update(library);
+
+    // Громкость треков измеряется в фоне один раз и хранится в кэше по идентификатору трека
+    LoudnessAnalyzer loudnessAnalyzer;
+    ReplayGain replayGain(library);
+    replayGain.load(rootPath + "\\loudness.cache");
+    replayGain.updateAlbums();
+    replayGain.requestMissing(loudnessAnalyzer);
+    engine.setReplayGain(&replayGain);
+
+    // Экран избранного открывается клавишей F поверх плеера, не останавливая главный цикл
+    FavoritesView favoritesView(font, sf::Vector2f(window.getSize()));
+
+    // Треки, добавленные или измененные за кадр: громкость измеряется только для них
+    std::vector<int> addedTracks;
 
     // Основной цикл обработки событий
     while (window.isOpen()) {
-        processEvents(window, buttons, music, audioFiles, currentTrackIndex, fadeTimer, activeButton, volumeSlider, volumeIndicator, isVolumeIndicatorDragged, images, currentImageIndex, imageSprite, favorites, favoritesFilePath, font);
-        
-        // Применение эффекта затухания кнопок
-        if (fadeTimer.getElapsedTime().asSeconds() < fadeDuration) {
-            float t = fadeTimer.getElapsedTime().asSeconds() / fadeDuration;
-            float alpha = t;
-            if (activeButton)
-                handleButtonPress(*activeButton, alpha * 255);
+        // Спим до события окна, следующего кадра анимации или срока проверки фоновых задач
+        frameScheduler.wait();
+
+        // Кадр, в котором ничего не произошло, не должен выделять память (см. AllocationCounter)
+        AllocationCounter::beginFrame();
+        bool isSteadyFrame = true;
+
+        if (processEvents(window, controls, engine, library, currentTrackIndex, animator, activeButton, isVolumeIndicatorDragged, collections, favoritesView, scene, equalizer, equalizerPreset, replayGain, volume)) {
+            frameScheduler.invalidate();
+            isSteadyFrame = false;
+        }
+
+        // Применяем изменения медиатеки, найденные с прошлого кадра
+        AllocationCounter::setSubsystem(AllocationCounter::Library);
+        addedTracks.clear();
+        bool isLibraryChanged = libraryScanner.takeResults(library, addedTracks);
+        if (libraryWatcher.takeChanges(library, addedTracks))
+            isLibraryChanged = true;
+        if (isLibraryChanged) {
+            collections.update(library);
+            replayGain.updateAlbums(addedTracks);
+            replayGain.requestMissing(addedTracks, loudnessAnalyzer);
+            frameScheduler.invalidate();
+            isSteadyFrame = false;
+        }
+
+        // Обход закончен: заменяем индекс новым, предварительно закрыв старый
+        if (!isLibraryIndexSaved && libraryScanner.isFinished()) {
+            libraryIndex.close();
+            LibraryIndex::commit(libraryIndexPath);
+            isLibraryIndexSaved = true;
+            isSteadyFrame = false;
+        }
+
+        // Запускаем треки, открытые в фоне, и готовим следующий трек плейлиста
+        AllocationCounter::setSubsystem(AllocationCounter::Playback);
+        if (engine.update())
+            isSteadyFrame = false;
+
+        // Движок сам перешел на следующий трек
+        int playingTrackIndex = 0;
+        if (engine.takeTrackChange(playingTrackIndex)) {
+            currentTrackIndex = playingTrackIndex;
+            frameScheduler.invalidate();
+            isSteadyFrame = false;
+        }
+
+        // Трек сменился: запрашиваем его обложку и заранее готовим обложку следующего
+        AllocationCounter::setSubsystem(AllocationCounter::Covers);
+        if (currentTrackIndex != coverTrackIndex && !library.getPath(currentTrackIndex).empty()) {
+            coverTrackIndex = currentTrackIndex;
+            isSteadyFrame = false;
+            coverCache.request(currentTrackIndex, library.getPath(currentTrackIndex));
+
+            int nextTrackIndex = library.getNext(currentTrackIndex);
+            if (nextTrackIndex >= 0 && nextTrackIndex != currentTrackIndex)
+                coverCache.prefetch(nextTrackIndex, library.getPath(nextTrackIndex));
         }
+        if (coverCache.update(coverUploadBudget)) {
+            setCoverImage(window, imageSprite, controls, coverCache.getTexture());
+            scene.invalidate(imageSprite);
+            frameScheduler.invalidate();
+            isSteadyFrame = false;
+        }
+
+        // Забираем измеренную громкость. Пока играет звук или идет анимация, анализ занимает одно ядро
+        if (replayGain.update(loudnessAnalyzer))
+            isSteadyFrame = false;
+        loudnessAnalyzer.setThrottled(engine.getStatus() == sf::SoundSource::Playing || !isSteadyFrame || animator.isActive());
+
+        // Применение эффекта затухания кнопок: анимации идут шагами, кадр нужен только к следующему шагу
+        AllocationCounter::setSubsystem(AllocationCounter::Animation);
+        if (animator.update()) {
+            scene.invalidate(controls);
+            frameScheduler.invalidate();
+        }
+        if (animator.isActive())
+            frameScheduler.wakeUpIn(animator.getTimeToNextStep());
+
         // Отображение имени текущего трека с анимацией
-        if (!audioFiles.empty()) {
-            std::string trackName = std::filesystem::path(audioFiles[currentTrackIndex]).filename().string();
-            trackNameText.setString(trackName);
-
-            float textWidth = trackNameText.getLocalBounds().width;
-            float centerX = (window.getSize().x) / 2;
-
-            static float textOffset = 0;
-            textOffset += 0.03f;
-            if (textOffset > textWidth + 500)
-                textOffset = -500;
-            trackNameText.setPosition(centerX - textOffset, buttons[0].getPosition().y - 100);
+        // Имя меняется только со сменой трека или его тегов, поэтому строка не собирается каждый кадр
+        if (!library.isEmpty() && (currentTrackIndex != titleTrackIndex || isLibraryChanged)) {
+            titleTrackIndex = currentTrackIndex;
+            if (trackNameText.setString(getTrackTitle(library, currentTrackIndex))) {
+                scene.invalidate(trackNameText);
+                frameScheduler.invalidate();
+            }
+            isSteadyFrame = false;
+        }
+
+        // Строка бежит, пока трек играет; кадр рисуется, только когда она сдвинулась на пиксель
+        sf::Time marqueeTime = std::min(marqueeClock.restart(), sf::milliseconds(100));
+        if (engine.getStatus() == sf::SoundSource::Playing) {
+            if (trackNameText.update(marqueeTime)) {
+                scene.invalidate(trackNameText);
+                frameScheduler.invalidate();
+            }
+            frameScheduler.wakeUpIn(trackNameText.getTimeToNextStep());
+        }
+
+        // Фоновые задачи, результаты которых нужно забрать без участия пользователя
+        if (!engine.isIdle() || coverCache.isBusy())
+            frameScheduler.wakeUpIn(backgroundPollInterval);
+        if (!isLibraryIndexSaved)
+            frameScheduler.wakeUpIn(backgroundPollInterval);
+        if (loudnessAnalyzer.isBusy())
+            frameScheduler.wakeUpIn(libraryPollInterval);
+        if (LibraryWatcher::isSupported())
+            frameScheduler.wakeUpIn(libraryPollInterval);
+
+        // Проверка выделений: цикл не засыпает, а первый трек запускается сам,
+        // чтобы устойчивыми были и кадры во время воспроизведения
+        if (AllocationCounter::isChecking()) {
+            if (!isCheckTrackStarted && !library.isEmpty()) {
+                isCheckTrackStarted = true;
+                if (library.getPath(currentTrackIndex).empty())
+                    currentTrackIndex = library.getNext(currentTrackIndex);
+                engine.playTrack(currentTrackIndex);
+                isSteadyFrame = false;
+            }
+            frameScheduler.wakeUpIn(sf::milliseconds(1));
+            if (AllocationCounter::isCheckFinished())
+                window.close();
         }
 
         // Отрисовка элементов на экране
-        draw(window, buttons, trackNameText, volumeSlider, volumeIndicator, imageSprite);
+        AllocationCounter::setSubsystem(AllocationCounter::Render);
+        if (frameScheduler.beginFrame())
+            draw(window, scene, favoritesView);
+
+        AllocationCounter::endFrame(isSteadyFrame);
     }
 
-    return 0;
+    return AllocationCounter::hasFailed() ? 1 : 0;
 }
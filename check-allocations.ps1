@@ -0,0 +1,77 @@
+﻿# Проверка выделений памяти в устойчивых кадрах (см. WavePleer/AllocationCounter.h).
+# Собирает конфигурацию Release-Alloc, создает временную медиатеку из одного сгенерированного WAV-файла
+# и запускает плеер: он сам включает трек и завершается, набрав SteadyFrames устойчивых кадров.
+# Ненулевой код выхода — устойчивый кадр выделил память или устойчивых кадров не набралось.
+param(
+    [int]$SteadyFrames = 600
+)
+
+$ErrorActionPreference = 'Stop'
+$repo = $PSScriptRoot
+
+# MSBuild из установленной Visual Studio
+$vswhere = Join-Path ${env:ProgramFiles(x86)} 'Microsoft Visual Studio\Installer\vswhere.exe'
+$msbuild = & $vswhere -latest -requires Microsoft.Component.MSBuild -find 'MSBuild\**\Bin\MSBuild.exe' | Select-Object -First 1
+& $msbuild (Join-Path $repo 'WavePleer.sln') /m /nologo /verbosity:minimal /p:Configuration=Release-Alloc /p:Platform=x64
+if ($LASTEXITCODE -ne 0) {
+    exit $LASTEXITCODE
+}
+
+# Временный корень программы со своими индексом медиатеки, кэшами и избранным, чтобы не трогать рабочие.
+# Программа запускается из его подкаталога Run: GetRootPath отбрасывает последний каталог рабочей директории
+$work = Join-Path ([IO.Path]::GetTempPath()) ('WavePleerCheck-' + [Guid]::NewGuid())
+$music = Join-Path $work 'Music'
+$run = Join-Path $work 'Run'
+New-Item -ItemType Directory -Path $music, $run | Out-Null
+Copy-Item (Join-Path $repo 'Assets'), (Join-Path $repo 'Covers') $work -Recurse
+
+# Пять секунд синуса 440 Гц: 44.1 кГц, 16 бит, стерео
+$rate = 44100
+$frames = $rate * 5
+$data = New-Object byte[] ($frames * 4)
+for ($i = 0; $i -lt $frames; $i++) {
+    $value = [int16](8000 * [Math]::Sin(2 * [Math]::PI * 440 * $i / $rate))
+    $bytes = [BitConverter]::GetBytes($value)
+    $data[4 * $i] = $bytes[0]
+    $data[4 * $i + 1] = $bytes[1]
+    $data[4 * $i + 2] = $bytes[0]
+    $data[4 * $i + 3] = $bytes[1]
+}
+
+$writer = New-Object IO.BinaryWriter([IO.File]::Create((Join-Path $music 'check.wav')))
+$writer.Write([Text.Encoding]::ASCII.GetBytes('RIFF'))
+$writer.Write([int](36 + $data.Length))
+$writer.Write([Text.Encoding]::ASCII.GetBytes('WAVEfmt '))
+$writer.Write([int]16)
+$writer.Write([int16]1)
+$writer.Write([int16]2)
+$writer.Write([int]$rate)
+$writer.Write([int]($rate * 4))
+$writer.Write([int16]4)
+$writer.Write([int16]16)
+$writer.Write([Text.Encoding]::ASCII.GetBytes('data'))
+$writer.Write([int]$data.Length)
+$writer.Write($data)
+$writer.Close()
+
+# Библиотеки SFML и OpenAL лежат рядом с проектом
+$env:WAVEPLEER_STEADY_FRAMES = $SteadyFrames
+$env:PATH = (Join-Path $repo 'WavePleer') + ';' + $env:PATH
+Push-Location $run
+try {
+    & (Join-Path $repo 'x64\Release-Alloc\WavePleer.exe') $music
+    $code = $LASTEXITCODE
+}
+finally {
+    Pop-Location
+    Remove-Item Env:WAVEPLEER_STEADY_FRAMES
+    Remove-Item $work -Recurse -Force
+}
+
+if ($code -ne 0) {
+    Write-Host 'Allocation check failed: see the frames reported above'
+}
+else {
+    Write-Host 'Allocation check passed'
+}
+exit $code